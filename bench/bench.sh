@@ -0,0 +1,113 @@
+#!/bin/sh
+# End-to-end benchmark of the solver over the graded grids of bench/corpus.
+# usage: bench.sh [-n RUNS] [-b BASELINE] [-s] [-t THRESHOLD] TAKUZU
+#   -n RUNS       runs of each case (default 5), the median and the p95 of the wall times are kept
+#   -b BASELINE   results of a previous run to compare with (default bench/baseline.txt if it exists)
+#   -s            save the results as the baseline instead of comparing
+#   -t THRESHOLD  slowdown (in %) of the median over the p95 of the baseline flagged as a regression (default 10)
+# The results are written in bench/last.txt, the exit status is 1 if a case regressed.
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+CORPUS=$DIR/corpus
+RUNS=5
+BASELINE=$DIR/baseline.txt
+SAVE=0
+THRESHOLD=10
+
+while getopts n:b:st: opt; do
+    case $opt in
+        n) RUNS=$OPTARG ;;
+        b) BASELINE=$OPTARG ;;
+        s) SAVE=1 ;;
+        t) THRESHOLD=$OPTARG ;;
+        *) exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+TAKUZU=${1:-$DIR/../takuzu}
+if [ ! -x "$TAKUZU" ]; then
+    echo "bench: $TAKUZU: no such executable" >&2
+    exit 2
+fi
+
+# the cases: name and arguments of the solver, by mode / size / difficulty
+cases() {
+    cat <<EOF
+first/8-easy       $CORPUS/8-easy.txt
+first/16-easy      $CORPUS/16-easy.txt
+first/16-medium    $CORPUS/16-medium.txt
+first/16-hard      $CORPUS/16-hard.txt
+first/32-easy      $CORPUS/32-easy.txt
+first/32-medium    $CORPUS/32-medium.txt
+first/32-hard      $CORPUS/32-hard.txt
+first/64-easy      $CORPUS/64-easy.txt
+cdcl/32-hard       --search=cdcl $CORPUS/32-hard.txt
+all/8-sparse       -a $CORPUS/8-sparse.txt
+all/16-sparse      -a $CORPUS/16-sparse.txt
+all-j2/16-sparse   -a -j2 $CORPUS/16-sparse.txt
+gen/8-unique       -g8 -u --seed=1
+gen/16-unique      -g16 -u --seed=1
+gen/32-full        -g32 --full --seed=1
+gen/64-full        -g64 --full --seed=1
+EOF
+}
+
+OUT=$DIR/last.txt
+RUNS_FILE=$(mktemp)
+trap 'rm -f "$RUNS_FILE"' EXIT
+
+# the runs of the cases are interleaved: a burst of noise on the machine is spread on all the cases
+for r in $(seq "$RUNS"); do
+    cases | while read -r name args; do
+        # wall time, nodes and solutions of the run, from the --stats line of the solver
+        # shellcheck disable=SC2086
+        "$TAKUZU" --stats $args -o /dev/null 2>&1 >/dev/null | sed -n "s|^stats: \([0-9]*\) nodes, \([0-9]*\) solutions, \([0-9.]*\)s.*|$name \3 \1 \2|p"
+    done
+done >"$RUNS_FILE"
+
+printf "%-18s %10s %10s %12s %12s %s\n" case median p95 nodes/s sol/s "vs baseline"
+sort -k1,1 -k2,2n "$RUNS_FILE" | awk -v base="$BASELINE" -v save="$SAVE" -v threshold="$THRESHOLD" -v out="$OUT" '
+    function report(name, n,    median, p95, cmp, line, f) {
+        median = n % 2 ? wall[(n + 1) / 2] : (wall[n / 2] + wall[n / 2 + 1]) / 2
+        p95 = wall[int(0.95 * n + 0.999999)]
+        cmp = ""
+        if (!save) {
+            while ((getline line < base) > 0) {
+                split(line, f, " ")
+                if (f[1] == name) {
+                    cmp = sprintf("%+.1f%%", 100 * (median - f[2]) / f[2])
+                    # slower than the p95 of the baseline by the threshold (and 2ms): not only noise
+                    if (median > f[3] * (1 + threshold / 100) && median > f[3] + 0.002) {
+                        cmp = cmp " REGRESSION"
+                    }
+                    if (f[4] != nodes) {
+                        cmp = cmp sprintf(" (nodes %d -> %d)", f[4], nodes)
+                    }
+                }
+            }
+            close(base)
+        }
+        printf "%-18s %10.4f %10.4f %12.0f %12.0f %s\n", name, median, p95, nodes / median, sol / median, cmp
+        printf "%s %.6f %.6f %d %d%s\n", name, median, p95, nodes, sol, (cmp ~ /REGRESSION/ ? " REGRESSION" : "") > out
+    }
+    $1 != name {
+        if (name != "") {
+            report(name, n)
+        }
+        name = $1
+        n = 0
+    }
+    { wall[++n] = $2; nodes = $3; sol = $4 }
+    END {
+        if (name != "") {
+            report(name, n)
+        }
+    }'
+
+if [ "$SAVE" = 1 ]; then
+    cp "$OUT" "$BASELINE"
+    echo "bench: baseline saved in $BASELINE"
+elif grep -q REGRESSION "$OUT"; then
+    echo "bench: regression against $BASELINE" >&2
+    exit 1
+fi
@@ -1,6 +1,7 @@
 #ifndef BACKTRACKING_H
 #define BACKTRACKING_H
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 #include "grid.h"
@@ -13,8 +14,23 @@ typedef struct {
     char choice;
 } choice_t;
 
+typedef enum { BRANCH_AROUND, BRANCH_FIRST, BRANCH_RANDOM, BRANCH_LINE, BRANCH_PATTERNS, BRANCH_ACTIVITY, NB_BRANCHING } t_branching;
+
+extern t_branching branching; // branching of grid_choice, BRANCH_AROUND by default
+
+typedef struct {
+    t_branching branching; // how the cell of a branch is chosen
+    bool one_first;        // try '1' before '0'
+    bool random_value;     // random value order at each branch (one_first is ignored)
+    unsigned int seed;     // state of rand_r for the random choices
+} t_strategy;
+
+choice_t grid_choice(t_grid*);
+choice_t grid_choice_strategy(t_grid*, t_strategy*);
 t_grid* grid_solver(t_grid*, const t_mode, FILE*);
 void find_solutionALL(t_grid*, int*, FILE*);
 void find_solution1(t_grid*, bool*, t_grid*);
+void find_solution_limit(t_grid*, int*, int, t_grid*);
+bool is_unique(t_grid*, choice_t*);
 
 #endif /*BACKTRACKING_H*/
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define BATCH_WINDOW 4 // grids in flight per solver thread, parsed but not written yet
+
+void batch_solve(char**, int, int, bool, bool, FILE*);
+
+#endif /* BATCH_H */
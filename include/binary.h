@@ -0,0 +1,33 @@
+#ifndef BINARY_H
+#define BINARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "grid.h"
+
+#define BINARY_MAGIC   "TKZB"
+#define BINARY_VERSION 1
+#define BINARY_HEADER  16 // magic, version, size, 2 reserved bytes, count (little endian)
+
+typedef enum { FORMAT_TEXT, FORMAT_BIN, FORMAT_LINE } t_format; // FORMAT_LINE: one line per grid (grid_print_line)
+
+extern t_format format; // format of the grids written by grid_write, FORMAT_TEXT by default
+
+size_t binary_record_size(int);
+
+bool binary_header(const uint8_t*, size_t, int*, long*);
+
+void binary_load(t_grid*, const uint8_t*);
+
+long binary_begin(FILE*, int);
+
+void binary_end(FILE*, long, int);
+
+void grid_write(t_grid*, FILE*);
+
+void convert_files(char**, int, FILE*);
+
+#endif /* BINARY_H */
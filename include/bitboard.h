@@ -0,0 +1,44 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+
+/*
+A line (row or column) of a grid is stored in two 64 bits masks:
+    - filled: bit k is set if the k-th cell of the line is not '_'
+    - ones:   bit k is set if the k-th cell of the line is '1'
+the zeros of the line are then (filled & ~ones)
+*/
+
+static inline uint64_t line_full_mask(int n) {
+    // mask with the n first bits set (n is at most 64)
+    return n >= 64 ? ~0ULL : (1ULL << n) - 1;
+}
+
+static inline int line_count(uint64_t bits) {
+    return __builtin_popcountll(bits);
+}
+
+static inline uint64_t line_zeros(uint64_t filled, uint64_t ones) {
+    return filled & ~ones;
+}
+
+static inline uint64_t line_triples(uint64_t bits) {
+    // bit k is set if the cells k, k+1 and k+2 are all in bits
+    return bits & (bits >> 1) & (bits >> 2);
+}
+
+static inline uint64_t line_pairs_border(uint64_t bits) {
+    // bit k is set if the cell k is just before or just after a pair [x x]
+    uint64_t pairs = bits & (bits >> 1);
+    return (pairs >> 1) | (pairs << 2);
+}
+
+static inline uint64_t line_pairs_middle(uint64_t bits) {
+    // bit k is set if the cell k is between two cells of bits [x _ x]
+    return (bits << 1) & (bits >> 1);
+}
+
+void lines_forced(const uint64_t*, const uint64_t*, int, uint64_t, uint64_t*, uint64_t*);
+
+#endif /* BITBOARD_H */
@@ -0,0 +1,8 @@
+#ifndef CDCL_H
+#define CDCL_H
+
+#include "grid.h"
+
+t_grid* find_solution_cdcl(t_grid*);
+
+#endif /* CDCL_H */
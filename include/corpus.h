@@ -0,0 +1,35 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "grid.h"
+
+typedef struct {
+    char* name;
+    const char* data; // the file, mapped in memory (or read if it can't be mapped)
+    size_t size;
+    bool mapped;
+    size_t pos;    // start of the next line to scan
+    int line;      // number of this line, from 1
+    int grid_line; // first line of the last grid read (its number from 1 in a binary file)
+
+    // binary file (binary.c): fixed size records after the header
+    bool binary;
+    int bin_size;  // size of the grids
+    long count;    // number of records
+    long next;     // next record to read
+} t_corpus;
+
+void corpus_open(t_corpus*, char*);
+
+bool corpus_next(t_corpus*, t_grid*);
+
+bool corpus_end(t_corpus*);
+
+bool corpus_seek(t_corpus*, long);
+
+void corpus_close(t_corpus*);
+
+#endif /* CORPUS_H */
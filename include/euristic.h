@@ -4,6 +4,12 @@
 #include <grid.h>
 #include <stdbool.h>
 
+typedef enum { PROPAGATE_BASIC, PROPAGATE_PARITY, PROPAGATE_PROBE } t_propagation; // each level adds to the previous one
+
+extern t_propagation propagation; // level of apply_propagation, PROPAGATE_BASIC by default
+
 bool apply_euristics(t_grid*);
 
+bool apply_propagation(t_grid*);
+
 #endif /* EURISTIC_H */
\ No newline at end of file
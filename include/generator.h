@@ -0,0 +1,14 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "grid.h"
+
+extern long dig_budget; // branches of a test of generate_unique (--dig-budget), 0: no limit, the tests are exact
+
+void generate_full(t_grid*);
+
+void generate_clues(t_grid*, int);
+
+void generate_unique(t_grid*);
+
+#endif /* GENERATOR_H */
@@ -5,14 +5,83 @@
 #define MAX_GRID_SIZE 64
 #define N             20
 
+#define LINE_INDEX_SIZE (2 * MAX_GRID_SIZE) // power of 2, at most half used
+
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 extern bool verbose;
 
+typedef struct {
+    uint64_t key; // ones mask of a full line
+    int count;    // number of full lines with this key, 0 if the slot is free
+} t_line_slot;
+
 typedef struct {
     int size;    // Number of elements in a row
     char** grid; // Pointer of the grid
+
+    // bitboard view of the grid, kept in sync by set_cell (see bitboard.h)
+    uint64_t row_filled[MAX_GRID_SIZE]; // bit j of row i: cell (i, j) is not '_'
+    uint64_t row_ones[MAX_GRID_SIZE];   // bit j of row i: cell (i, j) is '1'
+    uint64_t col_filled[MAX_GRID_SIZE]; // bit i of column j: cell (i, j) is not '_'
+    uint64_t col_ones[MAX_GRID_SIZE];   // bit i of column j: cell (i, j) is '1'
+
+    // consistency state, updated for the row and the column of each set_cell
+    uint64_t row_bad; // bit i: row i has 3 consecutive 0 / 1 or too many 0 / 1
+    uint64_t col_bad; // bit j: same for the column j
+    int dup_pairs;    // number of pairs of similar full rows / columns
+    int nb_filled;    // number of cells which are not '_'
+    bool conflict;    // a line has no valid pattern left (pattern.c), reset by grid_undo
+
+    // hash sets (open addressing) of the full rows / columns
+    t_line_slot row_index[LINE_INDEX_SIZE];
+    t_line_slot col_index[LINE_INDEX_SIZE];
+
+    // propagation queue of apply_euristics: lines with a cell assigned since their last visit
+    uint64_t dirty_rows;
+    uint64_t dirty_cols;
+
+    // domains of the rows / columns (pattern.c)
+    struct s_domains* domains;
+
+    // equal / opposite relations between the cells (parity.c), NULL until the propagation uses them
+    struct s_parity* parity;
+
+    // branching score of grid_choice (backtracking.c): filled cells among the 8 around each cell
+    uint64_t around[MAX_GRID_SIZE][4]; // bit j of around[i][b]: bit b of the score of the cell (i, j)
+    int around_row[MAX_GRID_SIZE];     // best score of an empty cell of the row i, -1 if the row is full
+    uint64_t around_rows[9];           // bit i: around_row[i] is s
+    uint64_t around_dirty;             // bit i: the row i changed since around_row[i] was computed
+
+    // line branchings of grid_choice (backtracking.c): the rows / columns with an empty cell by level
+    // of their score (lowest first), the changed lines are moved by lines_refresh
+    int line_kind;                     // branching of the levels, -1 if they are not built
+    int line_level[2 * MAX_GRID_SIZE]; // level of each row, then of each column, -1 if the line is full
+    uint64_t level_rows[64];           // bit i: the row i is at this level
+    uint64_t level_cols[64];           // bit j: the column j is at this level
+    uint64_t levels;                   // bit l: a line is at the level l
+    uint64_t line_dirty_rows;          // bit i: the score of the row i may have changed since its level was computed
+    uint64_t line_dirty_cols;          // bit j: same for the column j
+
+    // activity branching (backtracking.c): number of dead ends found on each line, never undone
+    unsigned int row_weight[MAX_GRID_SIZE];
+    unsigned int col_weight[MAX_GRID_SIZE];
+
+    // probe cache (euristic.c): changes of the grid when the last probe of each cell (i * size + j)
+    // found nothing, 0 if it was never probed
+    uint64_t* probe_key;
+    uint64_t changes; // cells written since the allocation, not undone (a probe gives it back): a value is one state of the grid
+
+    // undo trail: cells (i * size + j) assigned by set_cell, in order
+    int* trail;
+    int trail_len;
+    int trail_cap;
+
+    // block of the pool holding the buffers of the grid (pool.c), NULL once freed
+    struct s_block* block;
+    unsigned int block_uses; // uses of the block when the grid got it
 } t_grid;
 
 void grid_allocate(t_grid*, int);
@@ -21,21 +90,39 @@ void grid_free(t_grid*);
 
 void grid_print(t_grid*, FILE*);
 
-void file_parser(t_grid*, char*);
+void grid_print_line(t_grid*, FILE*);
+
+bool file_parser(t_grid*, char*, long);
 
 void grid_copy(t_grid*, t_grid*);
 
 void set_cell(int, int, t_grid*, char);
 
+void load_row(int, t_grid*, uint64_t, uint64_t);
+void load_done(t_grid*);
+
 char get_cell(int, int, t_grid*);
 
+int grid_trail_mark(t_grid*);
+
+void grid_undo(t_grid*, int);
+
+uint64_t grid_around_best(t_grid*, int, int*);
+
+void grid_around_refresh(t_grid*);
+
+int line_index_count(const t_line_slot*, uint64_t);
+
 void check_bound_error(int, int, t_grid*);
 
 bool is_consistent(t_grid*);
 
-bool is_valid(t_grid*);
+static inline bool grid_consistent(const t_grid* g) {
+    // state of is_consistent, without counting a check in the statistics
+    return g->row_bad == 0 && g->col_bad == 0 && g->dup_pairs == 0 && !g->conflict;
+}
 
-void fill_grid(t_grid*);
+bool is_valid(t_grid*);
 
 void set_empty_grid(t_grid*);
 
@@ -0,0 +1,14 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdio.h>
+
+#include "grid.h"
+
+#define MAX_JOBS 256
+
+int find_solutionALL_parallel(t_grid*, int, FILE*);
+
+t_grid* find_solution1_parallel(t_grid*, int);
+
+#endif /* PARALLEL_H */
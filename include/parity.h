@@ -0,0 +1,47 @@
+#ifndef PARITY_H
+#define PARITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "grid.h"
+
+typedef struct {
+    int stamp; // length of the cell trail when the classes were joined
+    int child; // root linked under another root by the join
+} t_parity_save;
+
+typedef struct s_parity {
+    /*
+    union-find with parity on the cells (i * size + j): a cell has the value of
+    its parent if its parity is 0, the other one if it is 1. No path
+    compression, the joins are undone in the reverse order.
+    */
+    int* parent;
+    unsigned char* parity;
+    int* class_size; // number of cells of the class, for its root
+    int* next;       // circular list of the cells of each class
+
+    // bitboards of the cells in a class of several cells (see grid.h)
+    uint64_t row_linked[MAX_GRID_SIZE];
+    uint64_t col_linked[MAX_GRID_SIZE];
+
+    // undo trail of the joins, undone with the cell trail of the grid
+    t_parity_save* trail;
+    int trail_len;
+    int trail_cap;
+} t_parity;
+
+void parity_allocate(t_grid*);
+
+void parity_free(t_grid*);
+
+void parity_copy(t_grid*, t_grid*);
+
+void parity_undo(t_grid*, int);
+
+int parity_find(t_grid*, int, int*);
+
+int parity_link(t_grid*, int, int, int);
+
+#endif /* PARITY_H */
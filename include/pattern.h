@@ -0,0 +1,41 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "grid.h"
+
+#define PATTERN_MAX_SIZE  16 // the valid lines are listed for the sizes up to this one
+#define PATTERN_MAX_EMPTY 12 // above, a line is completed in every way up to this number of empty cells
+
+typedef struct {
+    int stamp; // length of the cell trail when the domain was reduced
+    int line;  // rows are 0 to size - 1, columns size to 2 * size - 1
+    int size;  // size of the domain before the reduction
+} t_domain_save;
+
+typedef struct s_domains {
+    const uint64_t* patterns; // valid lines of this size, shared by all the grids
+    int nb_patterns;
+    uint16_t* items;                 // for each line, nb_patterns indices of patterns
+    int items_size[2 * MAX_GRID_SIZE]; // the domain of a line is its items_size first items
+    uint64_t ready;                    // bit of a line: its items are written, else its domain is all the patterns
+
+    // undo trail of the domains, undone with the cell trail of the grid
+    t_domain_save* trail;
+    int trail_len;
+    int trail_cap;
+} t_domains;
+
+void domains_allocate(t_grid*);
+
+void domains_free(t_grid*);
+
+void domains_copy(t_grid*, t_grid*);
+
+void domains_undo(t_grid*, int);
+
+bool pattern_forced(t_grid*, int, bool, uint64_t*, uint64_t*);
+
+#endif /* PATTERN_H */
@@ -0,0 +1,52 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "grid.h"
+
+typedef struct s_arena {
+    struct s_block* blocks; // blocks allocated in the arena and not freed yet
+    struct s_arena* prev;   // arena of the thread when this one was started
+} t_arena;
+
+typedef struct s_block {
+    /*
+    buffers of a grid of the pool: one allocation of a fixed size for each
+    grid size (the block, its probe keys, its row pointers and its cells),
+    the trail and the domains / parity allocated once and kept when the block
+    is recycled
+    */
+    int size;
+    uint64_t* probe_key;
+    char** grid;
+    int* trail;
+    int trail_cap;
+    struct s_domains* domains;
+    struct s_parity* parity;
+
+    unsigned int uses;     // releases of the block, to catch a grid freed by arena_end (pool.c)
+    const char* thread;    // thread which allocated the block (pool.c)
+    t_arena* arena;        // arena of the block while it is allocated, or NULL
+    struct s_block* prev;  // list of the arena
+    struct s_block* next;  // list of the arena, or free list of its size
+} t_block;
+
+void pool_get(t_grid*, int);
+
+void pool_put(t_grid*);
+
+void pool_parity(t_grid*);
+
+void pool_flush(void);
+
+void pool_clear(void);
+
+void arena_begin(t_arena*);
+
+void arena_keep(t_grid*);
+
+void arena_end(t_arena*);
+
+#endif /* POOL_H */
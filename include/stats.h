@@ -0,0 +1,62 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// rules of the propagation, for the cells they set
+typedef enum { RULE_CONSEC, RULE_MIDDLE, RULE_COMPLETE, RULE_WINDOWS, RULE_PARITY, RULE_PATTERNS, RULE_PROBE, NB_RULES } t_rule;
+
+// parts of the search, timed when stats_timing is set
+typedef enum { TIME_PROPAGATION, TIME_BRANCHING, TIME_VALIDATION, NB_TIMES } t_part;
+
+typedef struct {
+    unsigned long nodes;            // nodes of the search trees (decisions of cdcl)
+    unsigned long solutions;        // solutions found (the first one, or all of them with -a)
+    unsigned long backtracks;       // dead ends of the search trees (conflicts of cdcl)
+    unsigned long checks;           // calls of is_consistent
+    unsigned long forced[NB_RULES]; // cells set by each rule
+    uint64_t time[NB_TIMES];        // nanoseconds spent in each part
+    unsigned int depth;             // decisions on the current branch
+    unsigned int max_depth;
+} t_stats;
+
+extern _Thread_local t_stats stats; // counters of the current thread, added to the total by stats_merge
+
+extern bool stats_timing; // time the parts of the search (--stats=json), 2 clock reads per part
+
+static inline uint64_t stats_clock(void) {
+    struct timespec t;
+    if (!stats_timing) {
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static inline void stats_time(t_part part, uint64_t since) {
+    // add the time since the clock since (from stats_clock) to part
+    if (stats_timing) {
+        stats.time[part] += stats_clock() - since;
+    }
+}
+
+static inline void stats_descend(void) {
+    if (++stats.depth > stats.max_depth) {
+        stats.max_depth = stats.depth;
+    }
+}
+
+static inline void stats_ascend(void) {
+    stats.depth--;
+}
+
+void stats_start(void);
+
+void stats_merge(void);
+
+void stats_print(FILE*, bool);
+
+#endif /* STATS_H */
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "grid.h"
+
+#define TRACE_MAGIC   "TKZT"
+#define TRACE_VERSION 1
+#define TRACE_HEADER  8 // magic, version, size, 2 reserved bytes
+#define TRACE_RECORD  8 // depth, cell (i * size + j), cells propagated (16 bits little endian each), value (2 for the root), flags
+#define TRACE_ROOT    0xFFFF // cell of the root node
+
+enum { TRACE_FAILED = 1, TRACE_SOLUTION = 2 }; // flags of a node
+
+extern FILE* trace_fd; // file of the trace of the search (--trace), NULL if there is no trace
+
+void trace_open(const char*, int);
+
+void trace_close(void);
+
+void trace_set_branch(int, char);
+
+void trace_write_node(t_grid*, int);
+
+static inline void trace_branch(int cell, char v) {
+    // the next node of the search is the branch cell = v
+    if (trace_fd != NULL) {
+        trace_set_branch(cell, v);
+    }
+}
+
+static inline void trace_node(t_grid* g, int mark) {
+    // record the node of the last branch, with the cells set since the trail mark
+    if (trace_fd != NULL) {
+        trace_write_node(g, mark);
+    }
+}
+
+#endif /* TRACE_H */
@@ -1,56 +1,23 @@
+#include <err.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "backtracking.h"
+#include "binary.h"
+#include "bitboard.h"
 #include "euristic.h"
 #include "grid.h"
+#include "pattern.h"
+#include "pool.h"
+#include "stats.h"
+#include "trace.h"
 
-// static void fill_first_found_cell(t_grid* g, const char v) {
-//     unsigned int n = g->size;
-//     for (unsigned int i = 0; i < n; i++) {
-//         for (unsigned int j = 0; j < n; j++) {
-//             if (g->grid[i][j] == '_') {
-//                 set_cell(i, j, g, v);
-//             }
-//         }
-//     }
-// }
-
-// static void find_solution(t_grid* g, int* nb_sol) {
-
-//     apply_euristics(g);
-//     t_grid g1, g2;
-
-//     if (!is_consistent(g)){
-//         return;
-//     }
-
-//     if (is_valid(g)) {
-//         (*nb_sol)++;
-//         grid_print(g, NULL);
-//     }
-
-//     grid_copy(g, &g1);
-//     fill_first_found_cell(&g1, '0');
-//     find_solution(&g1, nb_sol);
-//     grid_free(&g1);
-
-//     grid_copy(g, &g2);
-//     fill_first_found_cell(&g2, '1');
-//     find_solution(&g2, nb_sol);
-//     grid_free(&g2);
-//     return;
-// }
-
-// void resolve_all(t_grid * g){
-//     int nb_sol = 0;
-//     find_solution(g, &nb_sol);
-
-//     printf("%d solutions found\n", nb_sol);
-// }
+t_branching branching = BRANCH_AROUND;
 
 static void grid_choice_apply(t_grid* g, const choice_t choice) {
-    //printf("%d %d %c\n",choice.row, choice.column, choice.choice);
     set_cell(choice.row, choice.column, g, choice.choice);
 }
 
@@ -61,177 +28,497 @@ static void grid_choice_print(choice_t choice, FILE* fd) {
     fprintf(fd, "verbose: choice: row = %d and column = %d\n", choice.row, choice.column);
 }
 
-static int filled_cell_around(t_grid* g, int i, int j) {
-    int cpt = 0;
-    check_bound_error(i, j, g);
-
-    // top left
-    if (i > 0 && j > 0 && g->grid[i - 1][j - 1] != '_') {
-        cpt++;
+static choice_t grid_choice_around(t_grid* g) {
+    /* we will try to chose the cell close to filled cell
+       to have a better usage of the euristics.
+       cell_write keeps the rows by best score of their empty cells (number
+       of filled cells among the 8 around), the first cell (row by row) of the
+       best score is taken */
+    choice_t choice = {-1, -1, '_'};
+    int score;
+    grid_around_refresh(g);
+    for (int s = 8; s >= 0; s--) {
+        if (g->around_rows[s]) {
+            choice.row = __builtin_ctzll(g->around_rows[s]);
+            choice.column = __builtin_ctzll(grid_around_best(g, choice.row, &score));
+            break;
+        }
     }
+    return choice;
+}
 
-    // top middle
-    if (i > 0 && g->grid[i - 1][j] != '_') {
-        cpt++;
+static int64_t line_score(t_grid* g, t_branching how, int line) {
+    /*
+    score of a line (rows 0 to n - 1, columns n to 2n - 1) with an empty cell, the lowest first:
+        BRANCH_LINE      number of empty cells
+        BRANCH_PATTERNS  number of valid patterns left (pattern.c), empty cells above PATTERN_MAX_SIZE
+        BRANCH_ACTIVITY  most dead ends found on the line (see apply_euristics), then empty cells
+    */
+    int n = g->size;
+    bool on_row = line < n;
+    int k = on_row ? line : line - n;
+    int64_t empty = line_count(line_full_mask(n) & ~(on_row ? g->row_filled[k] : g->col_filled[k]));
+
+    if (how == BRANCH_PATTERNS && g->domains != NULL) {
+        return g->domains->items_size[line];
+    } else if (how == BRANCH_ACTIVITY) {
+        return empty - (int64_t)(on_row ? g->row_weight[k] : g->col_weight[k]) * 2 * MAX_GRID_SIZE;
     }
+    return empty;
+}
 
-    // top right
-    if (i > 0 && j < g->size - 1 && g->grid[i - 1][j + 1] != '_') {
-        cpt++;
+static int line_level(t_grid* g, t_branching how, int line) {
+    // level (0 to 63) of a line with an empty cell: a line of a lower level has a lower score
+    int n = g->size;
+    unsigned int weight;
+
+    if (how == BRANCH_PATTERNS && g->domains != NULL) {
+        // number of bits of the number of patterns
+        return 63 - __builtin_clzll(g->domains->items_size[line] | 1);
+    } else if (how == BRANCH_ACTIVITY) {
+        // the most dead ends first: 32 minus their number of bits
+        weight = line < n ? g->row_weight[line] : g->col_weight[line - n];
+        return weight ? __builtin_clz(weight) : 32;
     }
+    return line_score(g, how, line) - 1;
+}
 
-    //middle left
-    if (j > 0 && g->grid[i][j - 1] != '_') {
-        cpt++;
-    }
+static void line_move(t_grid* g, int line, int level) {
+    // put the line at the level, -1 to take it out
+    int n = g->size;
+    uint64_t* masks = line < n ? g->level_rows : g->level_cols;
+    uint64_t bit = 1ULL << (line < n ? line : line - n);
+    int old = g->line_level[line];
 
-    // middle right
-    if (j < g->size - 1 && g->grid[i][j + 1] != '_') {
-        cpt++;
+    if (old == level) {
+        return;
     }
-
-    // bottom left
-    if (i < g->size - 1 && j > 0 && g->grid[i + 1][j - 1] != '_') {
-        cpt++;
+    if (old >= 0) {
+        masks[old] &= ~bit;
+        if (!(g->level_rows[old] | g->level_cols[old])) {
+            g->levels &= ~(1ULL << old);
+        }
     }
+    if (level >= 0) {
+        masks[level] |= bit;
+        g->levels |= 1ULL << level;
+    }
+    g->line_level[line] = level;
+}
 
-    // middle bottom
-    if (i < g->size - 1 && g->grid[i + 1][j] != '_') {
-        cpt++;
+static void lines_refresh(t_grid* g, t_branching how) {
+    /*
+    put the lines changed since the last call at the level of their score: the
+    cells written (cell_write), the domains reduced or undone (pattern.c) and
+    the dead ends (apply_euristics) mark their lines. All of them are put
+    again if the branching changed.
+    */
+    int n = g->size;
+    uint64_t full = line_full_mask(n);
+    int k;
+
+    if (g->line_kind != (int)how) {
+        memset(g->level_rows, 0, sizeof(g->level_rows));
+        memset(g->level_cols, 0, sizeof(g->level_cols));
+        g->levels = 0;
+        for (int line = 0; line < 2 * n; line++) {
+            g->line_level[line] = -1;
+        }
+        g->line_kind = how;
+        g->line_dirty_rows = full;
+        g->line_dirty_cols = full;
     }
+    for (; g->line_dirty_rows; g->line_dirty_rows &= g->line_dirty_rows - 1) {
+        k = __builtin_ctzll(g->line_dirty_rows);
+        line_move(g, k, g->row_filled[k] == full ? -1 : line_level(g, how, k));
+    }
+    for (; g->line_dirty_cols; g->line_dirty_cols &= g->line_dirty_cols - 1) {
+        k = __builtin_ctzll(g->line_dirty_cols);
+        line_move(g, n + k, g->col_filled[k] == full ? -1 : line_level(g, how, n + k));
+    }
+}
 
-    // bottom right
-    if (i < g->size - 1 && j < g->size - 1 && g->grid[i + 1][j + 1] != '_') {
-        cpt++;
+static int lines_best(t_grid* g, t_branching how, uint64_t rows, uint64_t cols) {
+    /*
+    the line of the lowest score among the rows / columns of the masks (with an
+    empty cell): only the ones of the lowest level with one of them are compared,
+    the first one if equal, rows before columns. -1 if the masks are empty.
+    */
+    int n = g->size;
+    uint64_t r, c;
+    int best = -1;
+    int64_t best_score = INT64_MAX;
+    int64_t score;
+    int l;
+
+    for (uint64_t m = g->levels; m; m &= m - 1) {
+        l = __builtin_ctzll(m);
+        r = g->level_rows[l] & rows;
+        c = g->level_cols[l] & cols;
+        if (!(r | c)) {
+            continue;
+        }
+        for (; r; r &= r - 1) {
+            score = line_score(g, how, __builtin_ctzll(r));
+            if (score < best_score) {
+                best_score = score;
+                best = __builtin_ctzll(r);
+            }
+        }
+        for (; c; c &= c - 1) {
+            score = line_score(g, how, n + __builtin_ctzll(c));
+            if (score < best_score) {
+                best_score = score;
+                best = n + __builtin_ctzll(c);
+            }
+        }
+        return best;
     }
+    return best;
+}
 
-    return cpt;
+static choice_t grid_choice_lines(t_grid* g, t_branching how) {
+    /*
+    the line with an empty cell of the lowest score (see line_score), then its
+    empty cell with the crossing line of the lowest score. The lines are kept by
+    level of their score (lines_refresh), only the lowest level is looked at.
+    */
+    int n = g->size;
+    uint64_t full = line_full_mask(n);
+    choice_t choice = {-1, -1, '_'};
+    uint64_t empty;
+    bool on_row;
+    int best, cell;
+
+    lines_refresh(g, how);
+    best = lines_best(g, how, full, full);
+    on_row = best < n;
+    best = on_row ? best : best - n;
+    empty = full & ~(on_row ? g->row_filled[best] : g->col_filled[best]);
+    cell = lines_best(g, how, on_row ? 0 : empty, on_row ? empty : 0);
+    cell = on_row ? cell - n : cell;
+
+    choice.row = on_row ? best : cell;
+    choice.column = on_row ? cell : best;
+    return choice;
 }
 
-static choice_t grid_choice(t_grid* g) {
-    /* we will try to chose the cell close to filled cell 
-       to have a better usage of the euristics.
-       To do that, we will store the current counter of the filled cells of the
-       8 cells around the cell studied*/
+choice_t grid_choice(t_grid* g) {
+    // cell of a branch with the global branching, the grid has an empty cell
+    t_strategy strategy = {branching, false, false, 0};
+    return grid_choice_strategy(g, &strategy);
+}
 
-    choice_t choice;
-    int maxi = 0;
-    int tmp;
+static choice_t grid_choice_first(t_grid* g) {
+    // first empty cell, row by row
+    choice_t choice = {-1, -1, '_'};
+    uint64_t empty;
     for (int i = 0; i < g->size; i++) {
-        for (int j = 0; j < g->size; j++) {
-            if (g->grid[i][j] == '_') {
-                tmp = filled_cell_around(g, i, j);
-                if (tmp > maxi) {
-                    choice.row = i;
-                    choice.column = j;
-                    maxi = tmp;
-                }
+        empty = ~g->row_filled[i] & line_full_mask(g->size);
+        if (empty) {
+            choice.row = i;
+            choice.column = __builtin_ctzll(empty);
+            break;
+        }
+    }
+    return choice;
+}
+
+static choice_t grid_choice_random(t_grid* g, unsigned int* seed) {
+    // an empty cell taken at random
+    choice_t choice = {-1, -1, '_'};
+    int k = rand_r(seed) % (g->size * g->size - g->nb_filled);
+    uint64_t empty;
+    for (int i = 0; i < g->size; i++) {
+        empty = ~g->row_filled[i] & line_full_mask(g->size);
+        if (k < line_count(empty)) {
+            // drop the k first empty cells of the row
+            for (; k > 0; k--) {
+                empty &= empty - 1;
             }
+            choice.row = i;
+            choice.column = __builtin_ctzll(empty);
+            break;
         }
+        k -= line_count(empty);
     }
+    return choice;
+}
 
+choice_t grid_choice_strategy(t_grid* g, t_strategy* strategy) {
+    // choose the cell and the first value of a branch, the grid has an empty cell
+    choice_t choice;
+    switch (strategy->branching) {
+        case BRANCH_FIRST:
+            choice = grid_choice_first(g);
+            break;
+        case BRANCH_RANDOM:
+            choice = grid_choice_random(g, &strategy->seed);
+            break;
+        case BRANCH_LINE:
+        case BRANCH_PATTERNS:
+        case BRANCH_ACTIVITY:
+            choice = grid_choice_lines(g, strategy->branching);
+            break;
+        default:
+            choice = grid_choice_around(g);
+            break;
+    }
+    if (strategy->random_value) {
+        choice.choice = rand_r(&strategy->seed) % 2 ? '1' : '0';
+    } else {
+        choice.choice = strategy->one_first ? '1' : '0';
+    }
     return choice;
 }
 
 void find_solution1(t_grid* g, bool* has_sol, t_grid* sol) {
-    if (!is_consistent(g) || *has_sol) {
+    /*
+    g is modified during the search but is given back as it was received:
+    each branch is undone with the trail of g instead of working on a copy
+    */
+    uint64_t t = stats_clock();
+    bool consistent = is_consistent(g);
+    bool valid = consistent && is_valid(g);
+    stats_time(TIME_VALIDATION, t);
+
+    if (!consistent || *has_sol) {
+        if (!consistent) {
+            stats.backtracks++;
+            trace_node(g, grid_trail_mark(g));
+        }
         return;
     }
+    stats.nodes++;
 
-    if (is_valid(g)) {
+    if (valid) {
+        trace_node(g, grid_trail_mark(g));
         if (sol != NULL) {
             grid_copy(g, sol);
         }
+        stats.solutions++;
         *has_sol = true;
         return;
     }
 
-    apply_euristics(g);
+    int mark = grid_trail_mark(g);
+    t = stats_clock();
+    apply_propagation(g);
+    stats_time(TIME_PROPAGATION, t);
+    trace_node(g, mark);
+
+    // the euristics can complete the grid or make it inconsistent
+    if (!is_consistent(g) || is_valid(g)) {
+        find_solution1(g, has_sol, sol);
+        grid_undo(g, mark);
+        return;
+    }
 
     // here, g is still consistent but not valid, so we keep trying to find solutions
-    t_grid g1, g2;
+    t = stats_clock();
     choice_t choice = grid_choice(g);
+    stats_time(TIME_BRANCHING, t);
     if (verbose) {
         grid_choice_print(choice, NULL);
     }
+    int branch = grid_trail_mark(g);
 
-    grid_copy(g, &g1);
+    stats_descend();
     choice.choice = '0';
-    grid_choice_apply(&g1, choice);
-    find_solution1(&g1, has_sol, sol);
-    grid_free(&g1);
+    trace_branch(choice.row * g->size + choice.column, choice.choice);
+    grid_choice_apply(g, choice);
+    find_solution1(g, has_sol, sol);
+    grid_undo(g, branch);
 
-    grid_copy(g, &g2);
     choice.choice = '1';
-    grid_choice_apply(&g2, choice);
-    find_solution1(&g2, has_sol, sol);
-    grid_free(&g2);
+    trace_branch(choice.row * g->size + choice.column, choice.choice);
+    grid_choice_apply(g, choice);
+    find_solution1(g, has_sol, sol);
+    stats_ascend();
+    grid_undo(g, mark);
 
     return;
 }
 
 void find_solutionALL(t_grid* g, int* nb_sol, FILE* fd) {
-    if (!is_consistent(g)) {
+    // same undo principle as find_solution1
+    uint64_t t = stats_clock();
+    bool consistent = is_consistent(g);
+    bool valid = consistent && is_valid(g);
+    stats_time(TIME_VALIDATION, t);
+
+    if (!consistent) {
+        stats.backtracks++;
+        trace_node(g, grid_trail_mark(g));
         return;
     }
-    if (is_valid(g)) {
+    stats.nodes++;
+    if (valid) {
+        trace_node(g, grid_trail_mark(g));
+        stats.solutions++;
         (*nb_sol)++;
         if (fd != NULL) {
-            grid_print(g, fd);
+            grid_write(g, fd);
         }
         return;
     }
 
-    apply_euristics(g);
+    int mark = grid_trail_mark(g);
+    t = stats_clock();
+    apply_propagation(g);
+    stats_time(TIME_PROPAGATION, t);
+    trace_node(g, mark);
+
+    // the euristics can complete the grid or make it inconsistent
+    if (!is_consistent(g) || is_valid(g)) {
+        find_solutionALL(g, nb_sol, fd);
+        grid_undo(g, mark);
+        return;
+    }
 
     // here, g is still consistent but not valid, so we keep trying to find solutions
-    t_grid g1, g2;
+    t = stats_clock();
     choice_t choice = grid_choice(g);
+    stats_time(TIME_BRANCHING, t);
     if (verbose) {
         grid_choice_print(choice, NULL);
     }
+    int branch = grid_trail_mark(g);
 
-    grid_copy(g, &g1);
+    stats_descend();
     choice.choice = '0';
-    grid_choice_apply(&g1, choice);
-    find_solutionALL(&g1, nb_sol, fd);
-    grid_free(&g1);
+    trace_branch(choice.row * g->size + choice.column, choice.choice);
+    grid_choice_apply(g, choice);
+    find_solutionALL(g, nb_sol, fd);
+    grid_undo(g, branch);
 
-    grid_copy(g, &g2);
     choice.choice = '1';
-    grid_choice_apply(&g2, choice);
-    find_solutionALL(&g2, nb_sol, fd);
-    grid_free(&g2);
+    trace_branch(choice.row * g->size + choice.column, choice.choice);
+    grid_choice_apply(g, choice);
+    find_solutionALL(g, nb_sol, fd);
+    stats_ascend();
+    grid_undo(g, mark);
 
     return;
 }
 
-t_grid* grid_solver(t_grid* tosolve, const t_mode mode, FILE* fd) {
+void find_solution_limit(t_grid* g, int* nb_sol, int limit, t_grid* sols) {
+    /*
+    same search as find_solutionALL, stops once limit solutions are found
+    if sols is not NULL, the k-th solution is copied in sols[k] (to free)
+    */
+    if (*nb_sol >= limit) {
+        return;
+    }
+    if (!is_consistent(g)) {
+        stats.backtracks++;
+        return;
+    }
+    stats.nodes++;
+    if (is_valid(g)) {
+        if (sols != NULL) {
+            grid_copy(g, &sols[*nb_sol]);
+        }
+        stats.solutions++;
+        (*nb_sol)++;
+        return;
+    }
+
+    int mark = grid_trail_mark(g);
+    apply_propagation(g);
+
+    if (!is_consistent(g) || is_valid(g)) {
+        find_solution_limit(g, nb_sol, limit, sols);
+        grid_undo(g, mark);
+        return;
+    }
+
+    choice_t choice = grid_choice(g);
+    int branch = grid_trail_mark(g);
 
+    choice.choice = '0';
+    grid_choice_apply(g, choice);
+    find_solution_limit(g, nb_sol, limit, sols);
+    grid_undo(g, branch);
+
+    choice.choice = '1';
+    grid_choice_apply(g, choice);
+    find_solution_limit(g, nb_sol, limit, sols);
+    grid_undo(g, mark);
+}
+
+bool is_unique(t_grid* g, choice_t* diff) {
+    /*
+    true if g has exactly one solution, the search stops at the second one.
+    g is given back as it was (undo trail).
+    If diff is not NULL, it is set to a cell where the two first solutions
+    differ with its value in the first one, or a row of -1 if there are not 2.
+    */
+    t_grid sols[2];
+    int nb_sol = 0;
+    uint64_t x;
+
+    find_solution_limit(g, &nb_sol, 2, diff != NULL ? sols : NULL);
+    if (diff != NULL) {
+        diff->row = -1;
+        if (nb_sol == 2) {
+            for (int i = 0; i < g->size && diff->row < 0; i++) {
+                x = sols[0].row_ones[i] ^ sols[1].row_ones[i];
+                if (x) {
+                    diff->row = i;
+                    diff->column = __builtin_ctzll(x);
+                    diff->choice = get_cell(i, diff->column, &sols[0]);
+                }
+            }
+        }
+        for (int k = 0; k < nb_sol; k++) {
+            grid_free(&sols[k]);
+        }
+    }
+    return nb_sol == 1;
+}
+
+t_grid* grid_solver(t_grid* tosolve, const t_mode mode, FILE* fd) {
+    /*
+    the search works on a copy because the euristics are applied on the grid,
+    we don't want to modify it. The copy is freed here, the grids of the
+    search left are given back with the arena of the solve, only the solution
+    is kept (to free with grid_free and free), NULL if no solution or in MODE_ALL
+    */
     bool has_sol = false;
+    int nbsol = 0;
+    t_grid* sol = NULL;
     t_grid g;
-    // copy because the first euristic is applied on the grid, we don't want to modify it.
-    grid_copy(tosolve, &g);
+    t_arena arena;
 
-    int nbsol = 0;
-    t_grid* sol = malloc(sizeof(t_grid));
-    if (sol == NULL) {
-        perror("grid_solver: ");
-    }
+    arena_begin(&arena);
+    grid_copy(tosolve, &g);
 
     switch (mode) {
         case MODE_FIRST:
+            sol = (t_grid*)malloc(sizeof(t_grid));
+            if (sol == NULL) {
+                perror("grid_solver");
+                exit(EXIT_FAILURE);
+            }
             find_solution1(&g, &has_sol, sol);
             if (has_sol) {
-                printf("solution found\n");
-                return sol;
+                warnx("info: solution found");
+                arena_keep(sol);
+            } else {
+                free(sol);
+                sol = NULL;
             }
-            return NULL;
+            break;
 
         case MODE_ALL:
             find_solutionALL(&g, &nbsol, fd);
-            fprintf(fd, "Number of solutions : %d\n", nbsol);
-            return NULL;
+            if (format != FORMAT_BIN) {
+                fprintf(fd, "Number of solutions : %d\n", nbsol);
+            }
+            break;
     }
-    return NULL;
-}
\ No newline at end of file
+    grid_free(&g);
+    arena_end(&arena);
+    return sol;
+}
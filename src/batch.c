@@ -0,0 +1,322 @@
+#include <err.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "backtracking.h"
+#include "batch.h"
+#include "binary.h"
+#include "cdcl.h"
+#include "corpus.h"
+#include "grid.h"
+#include "parallel.h"
+#include "pool.h"
+#include "stats.h"
+
+/*
+Batch mode: many input grids solved as a pipeline. A thread parses the
+grids of the files (corpus files, see corpus.c) in order, a pool of solver
+threads takes the parsed grids and writes the result of each one in a memory
+buffer, a last thread writes the buffers in the input order. The slots of the
+grids in flight are a ring of window slots: the grid k is parsed once the
+grid k - window is written.
+*/
+
+typedef struct {
+    t_grid g;
+    char* file; // origin of the grid, its file and its first line
+    int line;
+    int size;
+    char* text; // result of the grid, written by the output thread
+    size_t len;
+    bool solved; // has a solution
+    bool done;   // text is ready
+} t_slot;
+
+typedef struct {
+    char** files;
+    int nb_files;
+    bool all;
+    bool cdcl;
+    FILE* fd;
+
+    t_slot* slots;
+    int window;
+
+    // progress of the stages, protected by lock: grids [next_write, next_parse) are in the ring
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int next_parse;
+    int next_solve;
+    int next_write;
+    bool parse_done; // next_parse is the number of grids
+
+    // statistics, the busy time of each stage (solve: sum over the threads)
+    double parse_time;
+    double solve_time;
+    double write_time;
+    int nb_solved;
+} t_batch;
+
+static double batch_clock(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void* batch_parse(void* arg) {
+    t_batch* b = (t_batch*)arg;
+    t_corpus c;
+    t_slot* slot;
+    double start;
+    bool found;
+    int k = 0;
+
+    for (int f = 0; f < b->nb_files; f++) {
+        start = batch_clock();
+        corpus_open(&c, b->files[f]);
+        b->parse_time += batch_clock() - start;
+        do {
+            pthread_mutex_lock(&b->lock);
+            while (k - b->next_write >= b->window) {
+                pthread_cond_wait(&b->changed, &b->lock);
+            }
+            pthread_mutex_unlock(&b->lock);
+
+            slot = &b->slots[k % b->window];
+            start = batch_clock();
+            found = corpus_next(&c, &slot->g);
+            b->parse_time += batch_clock() - start;
+            if (!found) {
+                // only for the first grid of the file, the loop stops at its end
+                errx(EXIT_FAILURE, "error: %s: no grid in this file", b->files[f]);
+            }
+            slot->file = b->files[f];
+            slot->line = c.grid_line;
+            slot->size = slot->g.size;
+
+            pthread_mutex_lock(&b->lock);
+            b->next_parse = ++k;
+            pthread_cond_broadcast(&b->changed);
+            pthread_mutex_unlock(&b->lock);
+        } while (!corpus_end(&c));
+        corpus_close(&c);
+    }
+
+    pthread_mutex_lock(&b->lock);
+    b->parse_done = true;
+    pthread_cond_broadcast(&b->changed);
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+static void batch_run(t_batch* b, t_slot* slot, FILE* out) {
+    /*
+    solve the grid of the slot, its result is written in out as in the solver
+    mode for one file, only the solutions in the binary format
+    */
+    t_grid* g = &slot->g;
+
+    if (b->all) {
+        int nb_sol = 0;
+        find_solutionALL(g, &nb_sol, out);
+        if (format != FORMAT_BIN) {
+            fprintf(out, "Number of solutions : %d\n", nb_sol);
+        }
+        slot->solved = nb_sol > 0;
+        return;
+    }
+
+    t_grid* sol = NULL;
+    if (b->cdcl) {
+        sol = find_solution_cdcl(g);
+    } else {
+        bool has_sol = false;
+        sol = (t_grid*)malloc(sizeof(t_grid));
+        if (sol == NULL) {
+            perror("batch_run");
+            exit(EXIT_FAILURE);
+        }
+        find_solution1(g, &has_sol, sol);
+        if (!has_sol) {
+            free(sol);
+            sol = NULL;
+        }
+    }
+
+    slot->solved = sol != NULL;
+    if (sol == NULL && format == FORMAT_BIN) {
+        warnx("warning: %s:%d: no solution", slot->file, slot->line);
+        return;
+    } else if (sol == NULL) {
+        fprintf(out, "No solution for the input grid\n");
+        return;
+    }
+    if (format != FORMAT_BIN) {
+        fprintf(out, "found a solution for the input grid :\n\n");
+    }
+    grid_write(sol, out);
+    grid_free(sol);
+    free(sol);
+}
+
+static void* batch_solver(void* arg) {
+    t_batch* b = (t_batch*)arg;
+    t_slot* slot;
+    t_arena arena;
+    FILE* out;
+    double start;
+    int k;
+
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        while (b->next_solve == b->next_parse && !b->parse_done) {
+            pthread_cond_wait(&b->changed, &b->lock);
+        }
+        if (b->next_solve == b->next_parse) {
+            pthread_mutex_unlock(&b->lock);
+            stats_merge();
+            pool_flush();
+            return NULL;
+        }
+        k = b->next_solve++;
+        pthread_mutex_unlock(&b->lock);
+
+        slot = &b->slots[k % b->window];
+        start = batch_clock();
+        out = open_memstream(&slot->text, &slot->len);
+        if (out == NULL) {
+            perror("batch_solver");
+            exit(EXIT_FAILURE);
+        }
+        if (format != FORMAT_BIN) {
+            fprintf(out, "%s:%d:\n", slot->file, slot->line);
+        }
+        // the grids of the solve not freed by batch_run are given back at once
+        arena_begin(&arena);
+        batch_run(b, slot, out);
+        arena_end(&arena);
+        fclose(out);
+        grid_free(&slot->g);
+        start = batch_clock() - start;
+
+        pthread_mutex_lock(&b->lock);
+        b->solve_time += start;
+        b->nb_solved += slot->solved;
+        slot->done = true;
+        pthread_cond_broadcast(&b->changed);
+        pthread_mutex_unlock(&b->lock);
+    }
+}
+
+static void* batch_output(void* arg) {
+    t_batch* b = (t_batch*)arg;
+    t_slot* slot;
+    double start;
+    long header = -1; // binary output, written with the first solution
+    int n = 0;
+
+    for (int k = 0;; k++) {
+        slot = &b->slots[k % b->window];
+        pthread_mutex_lock(&b->lock);
+        while (!slot->done && !(b->parse_done && k == b->next_parse)) {
+            pthread_cond_wait(&b->changed, &b->lock);
+        }
+        pthread_mutex_unlock(&b->lock);
+        if (!slot->done) {
+            break;
+        }
+
+        start = batch_clock();
+        if (format == FORMAT_BIN && slot->len > 0) {
+            if (n == 0) {
+                n = slot->size;
+                header = binary_begin(b->fd, n);
+            } else if (slot->size != n) {
+                errx(EXIT_FAILURE, "error: %s:%d: a binary file only holds grids of size %d", slot->file, slot->line, n);
+            }
+        }
+        fwrite(slot->text, 1, slot->len, b->fd);
+        free(slot->text);
+        b->write_time += batch_clock() - start;
+
+        pthread_mutex_lock(&b->lock);
+        slot->done = false;
+        b->next_write = k + 1;
+        pthread_cond_broadcast(&b->changed);
+        pthread_mutex_unlock(&b->lock);
+    }
+    if (format == FORMAT_BIN) {
+        if (n == 0) {
+            header = binary_begin(b->fd, 0);
+        }
+        binary_end(b->fd, header, n);
+    }
+    fflush(b->fd);
+    return NULL;
+}
+
+void batch_solve(char** files, int nb_files, int nb_jobs, bool all, bool cdcl, FILE* fd) {
+    /*
+    solve the grids of the nb_files files with nb_jobs solver threads (first
+    solution, with cdcl or not, or all the solutions), the results are
+    written in fd in the order of the grids, each one after its file name
+    and the line of its first row.
+    The throughput of the batch is given at the end on stderr.
+    */
+    t_batch b;
+    pthread_t parser, output, solvers[MAX_JOBS];
+    double start = batch_clock();
+    double wall;
+
+    if (nb_jobs > MAX_JOBS) {
+        nb_jobs = MAX_JOBS;
+    }
+    b.files = files;
+    b.nb_files = nb_files;
+    b.all = all;
+    b.cdcl = cdcl;
+    b.fd = fd;
+    b.window = BATCH_WINDOW * nb_jobs;
+    b.slots = (t_slot*)calloc(b.window, sizeof(t_slot));
+    if (b.slots == NULL) {
+        perror("batch_solve");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&b.lock, NULL);
+    pthread_cond_init(&b.changed, NULL);
+    b.next_parse = 0;
+    b.next_solve = 0;
+    b.next_write = 0;
+    b.parse_done = false;
+    b.parse_time = 0;
+    b.solve_time = 0;
+    b.write_time = 0;
+    b.nb_solved = 0;
+
+    if (pthread_create(&parser, NULL, batch_parse, &b) != 0 || pthread_create(&output, NULL, batch_output, &b) != 0) {
+        perror("batch_solve");
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < nb_jobs; k++) {
+        if (pthread_create(&solvers[k], NULL, batch_solver, &b) != 0) {
+            perror("batch_solve");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_join(parser, NULL);
+    for (int k = 0; k < nb_jobs; k++) {
+        pthread_join(solvers[k], NULL);
+    }
+    pthread_join(output, NULL);
+
+    wall = batch_clock() - start;
+    warnx("info: batch: %d grids in %.3fs, %.1f grids/s, %d with a solution", b.next_parse, wall, b.next_parse / wall, b.nb_solved);
+    warnx("info: batch: parse %.3fs, solve %.3fs (%d threads), write %.3fs", b.parse_time, b.solve_time, nb_jobs, b.write_time);
+
+    pthread_cond_destroy(&b.changed);
+    pthread_mutex_destroy(&b.lock);
+    free(b.slots);
+}
@@ -0,0 +1,173 @@
+#include <err.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binary.h"
+#include "bitboard.h"
+#include "corpus.h"
+#include "grid.h"
+
+/*
+Binary grid files: a header of BINARY_HEADER bytes (the magic, the version,
+the size of the grids and their number) followed by fixed size records, so
+the grid k is at BINARY_HEADER + k * binary_record_size(size). A record is
+2 bits per cell: the bit plane of the filled cells then the one of the ones,
+n * n bits each, row by row, the cell (i, j) at the bit i * n + j (bit 0 of a
+byte first). The count is 0 if it couldn't be written at the end (a pipe),
+the number of records is then given by the size of the file.
+*/
+
+t_format format = FORMAT_TEXT;
+
+size_t binary_record_size(int n) {
+    // 2 planes of n * n bits, n is a multiple of 4
+    return (size_t)n * n / 4;
+}
+
+static void plane_put(uint8_t* p, int n, int i, uint64_t bits) {
+    // the n bits of the row i, p is cleared, a row of 4 cells is a half byte
+    int off = i * n;
+    for (int k = 0; k < n; k += 8) {
+        p[(off + k) / 8] |= (uint8_t)((bits >> k) << (off % 8));
+    }
+}
+
+static uint64_t plane_get(const uint8_t* p, int n, int i) {
+    int off = i * n;
+    uint64_t bits = 0;
+    for (int k = 0; k < n; k += 8) {
+        bits |= (uint64_t)(p[(off + k) / 8] >> (off % 8)) << k;
+    }
+    return bits & line_full_mask(n);
+}
+
+bool binary_header(const uint8_t* data, size_t len, int* n, long* count) {
+    // read the header of a binary file (starting with BINARY_MAGIC), false if its version is unknown
+    uint64_t c = 0;
+    if (len < BINARY_HEADER || data[4] != BINARY_VERSION) {
+        return false;
+    }
+    *n = data[5];
+    for (int k = 7; k >= 0; k--) {
+        c = c << 8 | data[8 + k];
+    }
+    *count = (long)c;
+    return true;
+}
+
+static void header_write(uint8_t* h, int n, long count) {
+    memset(h, 0, BINARY_HEADER);
+    memcpy(h, BINARY_MAGIC, 4);
+    h[4] = BINARY_VERSION;
+    h[5] = (uint8_t)n;
+    for (int k = 0; k < 8; k++) {
+        h[8 + k] = (uint8_t)((uint64_t)count >> (8 * k));
+    }
+}
+
+void binary_load(t_grid* g, const uint8_t* rec) {
+    // the record rec in the grid g, allocated with its size and empty
+    int n = g->size;
+    const uint8_t* ones = rec + binary_record_size(n) / 2;
+    uint64_t f;
+
+    for (int i = 0; i < n; i++) {
+        f = plane_get(rec, n, i);
+        load_row(i, g, f, plane_get(ones, n, i) & f);
+    }
+    load_done(g);
+}
+
+static void binary_record(t_grid* g, FILE* fd) {
+    uint8_t rec[MAX_GRID_SIZE * MAX_GRID_SIZE / 4];
+    int n = g->size;
+    size_t len = binary_record_size(n);
+
+    memset(rec, 0, len);
+    for (int i = 0; i < n; i++) {
+        plane_put(rec, n, i, g->row_filled[i]);
+        plane_put(rec + len / 2, n, i, g->row_ones[i]);
+    }
+    fwrite(rec, 1, len, fd);
+}
+
+long binary_begin(FILE* fd, int n) {
+    /*
+    write the header of a binary file of grids of size n (0 if there is no
+    grid), return its position to give the count to binary_end, -1 if fd
+    can't seek
+    */
+    uint8_t h[BINARY_HEADER];
+    long start = ftell(fd);
+
+    header_write(h, n, 0);
+    fwrite(h, 1, BINARY_HEADER, fd);
+    return start;
+}
+
+void binary_end(FILE* fd, long start, int n) {
+    // write the count of the records after the header at start, kept to 0 if fd can't seek
+    uint8_t h[BINARY_HEADER];
+    long end = ftell(fd);
+    long count = n != 0 ? (end - start - BINARY_HEADER) / (long)binary_record_size(n) : 0;
+
+    if (start < 0 || end < 0 || fseek(fd, start + 8, SEEK_SET) != 0) {
+        return;
+    }
+    header_write(h, n, count);
+    fwrite(h + 8, 1, 8, fd);
+    fseek(fd, end, SEEK_SET);
+}
+
+void grid_write(t_grid* g, FILE* fd) {
+    // write a solution or a generated grid in the output format
+    if (format == FORMAT_BIN) {
+        binary_record(g, fd);
+    } else if (format == FORMAT_LINE) {
+        grid_print_line(g, fd);
+    } else {
+        grid_print(g, fd);
+    }
+}
+
+void convert_files(char** files, int nb_files, FILE* fd) {
+    /*
+    write the grids of the files (text or binary) in the output format,
+    without solving them. All the grids of a binary file have the same size.
+    */
+    t_corpus c;
+    t_grid g;
+    long start = -1;
+    long count = 0;
+    int n = 0;
+
+    for (int f = 0; f < nb_files; f++) {
+        corpus_open(&c, files[f]);
+        while (corpus_next(&c, &g)) {
+            if (format == FORMAT_BIN && count == 0) {
+                n = g.size;
+                start = binary_begin(fd, n);
+            } else if (format == FORMAT_BIN && g.size != n) {
+                errx(EXIT_FAILURE, "error: %s:%d: a binary file only holds grids of size %d", files[f], c.grid_line, n);
+            }
+            grid_write(&g, fd);
+            grid_free(&g);
+            count++;
+        }
+        corpus_close(&c);
+    }
+
+    if (format == FORMAT_BIN) {
+        if (count == 0) {
+            start = binary_begin(fd, 0);
+        }
+        binary_end(fd, start, n);
+    }
+    fflush(fd);
+    if (verbose) {
+        printf("verbose: %ld grid(s) converted\n", count);
+    }
+}
@@ -0,0 +1,36 @@
+#include <stdint.h>
+
+#include "bitboard.h"
+
+/*
+Kernels working on many lines at once. The loops are vectorized by the
+compiler: with target_clones the AVX2 version (4 lines per register) is
+chosen at load time when the CPU has it, the default one uses SSE2.
+*/
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define KERNEL_CLONES __attribute__((target_clones("avx2", "default")))
+#endif
+#endif
+#ifndef KERNEL_CLONES
+#define KERNEL_CLONES
+#endif
+
+KERNEL_CLONES
+void lines_forced(const uint64_t* restrict filled, const uint64_t* restrict ones, int nb, uint64_t full, uint64_t* restrict to_one, uint64_t* restrict to_zero) {
+    /*
+    for the nb lines, the empty cells forced by the windows of 3 cells:
+    [_ x x], [x x _] and [x _ x] force the empty cell to the opposite of x
+    */
+    uint64_t f, o, z, empty, pz, po;
+    for (int k = 0; k < nb; k++) {
+        f = filled[k];
+        o = ones[k];
+        z = f & ~o;
+        empty = full & ~f;
+        pz = z & (z >> 1);
+        po = o & (o >> 1);
+        to_one[k] = ((pz >> 1) | (pz << 2) | ((z << 1) & (z >> 1))) & empty;
+        to_zero[k] = ((po >> 1) | (po << 2) | ((o << 1) & (o >> 1))) & empty;
+    }
+}
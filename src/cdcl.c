@@ -0,0 +1,679 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitboard.h"
+#include "cdcl.h"
+#include "grid.h"
+#include "stats.h"
+
+/*
+clause learning search. The variable of the cell (i, j) is v = i * n + j, the
+literal 2 * v means "(i, j) is 1" and 2 * v + 1 means "(i, j) is 0".
+The rule of the 3 consecutive values is encoded as clauses. The balance and
+the different lines rules are checked on the bitboards of the assigned cells,
+what they deduce is explained by the set of the assigned cells involved.
+A conflict is analysed into a learnt clause (first unique implication point),
+the search jumps back to the level where this clause deduces a new value.
+*/
+
+#define LIT(v, b)   (2 * (v) + !(b))
+#define LIT_VAR(l)  ((l) >> 1)
+#define LIT_BOOL(l) (!((l) & 1))
+
+#define NO_REASON    -1   // decision or clue, also "no conflict"
+#define VAR_DECAY    0.95 // the activities of the variables fade after each conflict
+#define RESTART_BASE 100  // conflicts between 2 restarts, times the Luby sequence
+
+typedef struct {
+    int* items;
+    int len;
+    int cap;
+} t_ivec;
+
+typedef struct {
+    int n;
+    int nb_vars;
+
+    signed char* value; // -1 if the cell is not assigned, else its value
+    signed char* phase; // last value of the cell, tried first
+    int* level;
+    int* reason; // NO_REASON, a clause of db (>= 0) or a set of arena (-2 - offset)
+    bool* seen;
+
+    int* trail; // literals assigned, in order
+    int trail_len;
+    int qhead;      // next literal of the trail to propagate
+    int* trail_lim; // start of each decision level in the trail
+    int* arena_lim; // size of arena at the start of each decision level
+    int nb_levels;
+
+    // clauses (size, literals), the 2 first literals of a clause are watched
+    t_ivec db;
+    t_ivec* watches; // clauses where a literal is watched
+
+    // reasons of the balance and different lines rules (size, false literals), popped on backtrack
+    t_ivec arena;
+
+    // cells not assigned, in a heap on their activity
+    double* activity;
+    double var_inc;
+    int* heap;
+    int* heap_pos; // -1 if the cell is not in the heap
+    int heap_len;
+
+    uint64_t row_filled[MAX_GRID_SIZE];
+    uint64_t row_ones[MAX_GRID_SIZE];
+    uint64_t col_filled[MAX_GRID_SIZE];
+    uint64_t col_ones[MAX_GRID_SIZE];
+
+    long conflicts;
+    long decisions;
+    long restarts;
+    int nb_learnt;
+} t_cdcl;
+
+static void* cdcl_alloc(size_t size) {
+    void* p = calloc(1, size);
+    if (p == NULL) {
+        perror("cdcl_alloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void ivec_push(t_ivec* vec, int x) {
+    if (vec->len == vec->cap) {
+        vec->cap = vec->cap ? 2 * vec->cap : 8;
+        vec->items = (int*)realloc(vec->items, sizeof(int) * vec->cap);
+        if (vec->items == NULL) {
+            perror("ivec_push");
+            exit(EXIT_FAILURE);
+        }
+    }
+    vec->items[vec->len++] = x;
+}
+
+static int lit_value(t_cdcl* s, int l) {
+    // -1 if not assigned, else 1 if the literal is true
+    signed char v = s->value[LIT_VAR(l)];
+    return v < 0 ? -1 : v == LIT_BOOL(l);
+}
+
+static int line_var(t_cdcl* s, int k, bool is_row, int c) {
+    // cell c of the row / column k
+    return is_row ? k * s->n + c : c * s->n + k;
+}
+
+/*
+heap of the cells on their activity
+*/
+
+static void heap_up(t_cdcl* s, int k) {
+    int v = s->heap[k];
+    int parent;
+    while (k > 0) {
+        parent = (k - 1) / 2;
+        if (s->activity[s->heap[parent]] >= s->activity[v]) {
+            break;
+        }
+        s->heap[k] = s->heap[parent];
+        s->heap_pos[s->heap[k]] = k;
+        k = parent;
+    }
+    s->heap[k] = v;
+    s->heap_pos[v] = k;
+}
+
+static void heap_down(t_cdcl* s, int k) {
+    int v = s->heap[k];
+    int child;
+    for (;;) {
+        child = 2 * k + 1;
+        if (child >= s->heap_len) {
+            break;
+        }
+        if (child + 1 < s->heap_len && s->activity[s->heap[child + 1]] > s->activity[s->heap[child]]) {
+            child++;
+        }
+        if (s->activity[s->heap[child]] <= s->activity[v]) {
+            break;
+        }
+        s->heap[k] = s->heap[child];
+        s->heap_pos[s->heap[k]] = k;
+        k = child;
+    }
+    s->heap[k] = v;
+    s->heap_pos[v] = k;
+}
+
+static void heap_insert(t_cdcl* s, int v) {
+    if (s->heap_pos[v] >= 0) {
+        return;
+    }
+    s->heap[s->heap_len] = v;
+    s->heap_pos[v] = s->heap_len;
+    s->heap_len++;
+    heap_up(s, s->heap_len - 1);
+}
+
+static int heap_pop(t_cdcl* s) {
+    int v = s->heap[0];
+    s->heap_pos[v] = -1;
+    s->heap_len--;
+    if (s->heap_len > 0) {
+        s->heap[0] = s->heap[s->heap_len];
+        s->heap_pos[s->heap[0]] = 0;
+        heap_down(s, 0);
+    }
+    return v;
+}
+
+static void bump(t_cdcl* s, int v) {
+    // a cell seen in a conflict is chosen sooner
+    s->activity[v] += s->var_inc;
+    if (s->activity[v] > 1e100) {
+        for (int k = 0; k < s->nb_vars; k++) {
+            s->activity[k] *= 1e-100;
+        }
+        s->var_inc *= 1e-100;
+    }
+    if (s->heap_pos[v] >= 0) {
+        heap_up(s, s->heap_pos[v]);
+    }
+}
+
+/*
+assignment and backtrack
+*/
+
+static void assign(t_cdcl* s, int l, int reason) {
+    int v = LIT_VAR(l);
+    int i = v / s->n;
+    int j = v % s->n;
+
+    s->value[v] = LIT_BOOL(l);
+    s->level[v] = s->nb_levels;
+    s->reason[v] = reason;
+    s->trail[s->trail_len++] = l;
+
+    s->row_filled[i] |= 1ULL << j;
+    s->col_filled[j] |= 1ULL << i;
+    if (LIT_BOOL(l)) {
+        s->row_ones[i] |= 1ULL << j;
+        s->col_ones[j] |= 1ULL << i;
+    }
+}
+
+static void new_level(t_cdcl* s) {
+    s->trail_lim[s->nb_levels] = s->trail_len;
+    s->arena_lim[s->nb_levels] = s->arena.len;
+    s->nb_levels++;
+    if ((unsigned int)s->nb_levels > stats.max_depth) {
+        stats.max_depth = s->nb_levels;
+    }
+}
+
+static void backtrack(t_cdcl* s, int level) {
+    // undo the assignments of the levels above level
+    int v, i, j;
+    if (s->nb_levels <= level) {
+        return;
+    }
+    for (int k = s->trail_len - 1; k >= s->trail_lim[level]; k--) {
+        v = LIT_VAR(s->trail[k]);
+        i = v / s->n;
+        j = v % s->n;
+        s->phase[v] = s->value[v];
+        s->value[v] = -1;
+        s->row_filled[i] &= ~(1ULL << j);
+        s->row_ones[i] &= ~(1ULL << j);
+        s->col_filled[j] &= ~(1ULL << i);
+        s->col_ones[j] &= ~(1ULL << i);
+        heap_insert(s, v);
+    }
+    s->trail_len = s->trail_lim[level];
+    s->qhead = s->trail_len;
+    s->arena.len = s->arena_lim[level];
+    s->nb_levels = level;
+}
+
+/*
+clauses and reasons
+*/
+
+static int add_clause(t_cdcl* s, const int* lits, int size) {
+    int c = s->db.len;
+    ivec_push(&s->db, size);
+    for (int k = 0; k < size; k++) {
+        ivec_push(&s->db, lits[k]);
+    }
+    ivec_push(&s->watches[lits[0]], c);
+    ivec_push(&s->watches[lits[1]], c);
+    return c;
+}
+
+static int* reason_lits(t_cdcl* s, int ref, int* size) {
+    int* base = ref >= 0 ? &s->db.items[ref] : &s->arena.items[-2 - ref];
+    *size = base[0];
+    return base + 1;
+}
+
+static int arena_begin(t_cdcl* s) {
+    int off = s->arena.len;
+    ivec_push(&s->arena, 0);
+    return off;
+}
+
+static void arena_add_line(t_cdcl* s, int off, int k, bool is_row, uint64_t mask) {
+    // add the false literals of the assigned cells of mask in the line k
+    int v;
+    for (uint64_t m = mask; m; m &= m - 1) {
+        v = line_var(s, k, is_row, __builtin_ctzll(m));
+        ivec_push(&s->arena, LIT(v, !s->value[v]));
+        s->arena.items[off]++;
+    }
+}
+
+/*
+propagation
+*/
+
+static int check_balance(t_cdcl* s, int k, bool is_row) {
+    /*
+    a line with n / 2 cells of a value gets the other value in its empty cells,
+    return a conflict if it has more
+    */
+    int half = s->n / 2;
+    uint64_t full = line_full_mask(s->n);
+    uint64_t filled = is_row ? s->row_filled[k] : s->col_filled[k];
+    uint64_t ones = is_row ? s->row_ones[k] : s->col_ones[k];
+    uint64_t empty = full & ~filled;
+    uint64_t same;
+    int cnt, off;
+
+    for (int b = 1; b >= 0; b--) {
+        same = b ? ones : filled & ~ones;
+        cnt = line_count(same);
+        if (cnt > half) {
+            // half + 1 of them are enough
+            for (; cnt > half + 1; cnt--) {
+                same &= same - 1;
+            }
+            off = arena_begin(s);
+            arena_add_line(s, off, k, is_row, same);
+            return -2 - off;
+        }
+        if (cnt == half && empty) {
+            off = arena_begin(s);
+            arena_add_line(s, off, k, is_row, same);
+            for (uint64_t m = empty; m; m &= m - 1) {
+                assign(s, LIT(line_var(s, k, is_row, __builtin_ctzll(m)), !b), -2 - off);
+            }
+            return NO_REASON;
+        }
+    }
+    return NO_REASON;
+}
+
+static int check_distinct(t_cdcl* s, int k, bool is_row) {
+    /*
+    a full line and a line equal to it but for an empty cell: this cell gets
+    the other value. Return a conflict if 2 full lines are equal.
+    */
+    uint64_t* filled = is_row ? s->row_filled : s->col_filled;
+    uint64_t* ones = is_row ? s->row_ones : s->col_ones;
+    uint64_t full = line_full_mask(s->n);
+    int nb_empty = s->n - line_count(filled[k]);
+    int a, b, c, off;
+
+    if (nb_empty > 1) {
+        return NO_REASON;
+    }
+    for (int m = 0; m < s->n; m++) {
+        // a is full, b is full or has one empty cell
+        if (m == k) {
+            continue;
+        }
+        if (nb_empty == 1) {
+            if (filled[m] != full) {
+                continue;
+            }
+            a = m;
+            b = k;
+        } else {
+            if (s->n - line_count(filled[m]) > 1) {
+                continue;
+            }
+            a = k;
+            b = m;
+        }
+        if (((ones[a] ^ ones[b]) & filled[b]) != 0) {
+            continue;
+        }
+
+        off = arena_begin(s);
+        arena_add_line(s, off, a, is_row, full);
+        arena_add_line(s, off, b, is_row, filled[b]);
+        if (filled[b] == full) {
+            return -2 - off;
+        }
+        c = __builtin_ctzll(full & ~filled[b]);
+        assign(s, LIT(line_var(s, b, is_row, c), !((ones[a] >> c) & 1)), -2 - off);
+        if (b == k) {
+            // k is full now, it is checked again when its new cell is propagated
+            return NO_REASON;
+        }
+    }
+    return NO_REASON;
+}
+
+static int propagate(t_cdcl* s) {
+    // propagate the trail, return a conflict (clause or set of false literals) or NO_REASON
+    int p, false_lit, c, size, v, confl;
+    int* lits;
+    t_ivec* ws;
+    bool moved;
+
+    while (s->qhead < s->trail_len) {
+        p = s->trail[s->qhead++];
+        false_lit = p ^ 1;
+        ws = &s->watches[false_lit];
+        confl = NO_REASON;
+
+        int i, j;
+        for (i = j = 0; i < ws->len; i++) {
+            c = ws->items[i];
+            size = s->db.items[c];
+            lits = &s->db.items[c + 1];
+            if (lits[0] == false_lit) {
+                lits[0] = lits[1];
+                lits[1] = false_lit;
+            }
+            if (lit_value(s, lits[0]) == 1) {
+                ws->items[j++] = c;
+                continue;
+            }
+
+            // another literal to watch
+            moved = false;
+            for (int k = 2; k < size; k++) {
+                if (lit_value(s, lits[k]) != 0) {
+                    lits[1] = lits[k];
+                    lits[k] = false_lit;
+                    ivec_push(&s->watches[lits[1]], c);
+                    moved = true;
+                    break;
+                }
+            }
+            if (moved) {
+                continue;
+            }
+
+            ws->items[j++] = c;
+            if (lit_value(s, lits[0]) == 0) {
+                confl = c;
+                for (i++; i < ws->len; i++) {
+                    ws->items[j++] = ws->items[i];
+                }
+                break;
+            }
+            assign(s, lits[0], c);
+        }
+        ws->len = j;
+        if (confl != NO_REASON) {
+            return confl;
+        }
+
+        v = LIT_VAR(p);
+        if ((confl = check_balance(s, v / s->n, true)) != NO_REASON || (confl = check_balance(s, v % s->n, false)) != NO_REASON
+            || (confl = check_distinct(s, v / s->n, true)) != NO_REASON || (confl = check_distinct(s, v % s->n, false)) != NO_REASON) {
+            return confl;
+        }
+    }
+    return NO_REASON;
+}
+
+/*
+conflict analysis and search
+*/
+
+static int analyze(t_cdcl* s, int confl, t_ivec* learnt) {
+    /*
+    learnt gets the clause of the first unique implication point of the
+    conflict, its first literal is the one to assert. Return the level to
+    jump back to.
+    */
+    int path = 0;
+    int p = -1;
+    int idx = s->trail_len - 1;
+    int size, q, v, level, pos, tmp;
+    int* lits;
+
+    learnt->len = 0;
+    ivec_push(learnt, -1);
+    do {
+        lits = reason_lits(s, confl, &size);
+        for (int k = 0; k < size; k++) {
+            q = lits[k];
+            v = LIT_VAR(q);
+            if ((p >= 0 && v == LIT_VAR(p)) || s->seen[v] || s->level[v] == 0) {
+                continue;
+            }
+            bump(s, v);
+            s->seen[v] = true;
+            if (s->level[v] == s->nb_levels) {
+                path++;
+            } else {
+                ivec_push(learnt, q);
+            }
+        }
+        while (!s->seen[LIT_VAR(s->trail[idx])]) {
+            idx--;
+        }
+        p = s->trail[idx--];
+        confl = s->reason[LIT_VAR(p)];
+        s->seen[LIT_VAR(p)] = false;
+        path--;
+    } while (path > 0);
+    learnt->items[0] = p ^ 1;
+
+    // the literal of the highest level is watched with the asserted one
+    level = 0;
+    pos = 1;
+    for (int k = 1; k < learnt->len; k++) {
+        s->seen[LIT_VAR(learnt->items[k])] = false;
+        if (s->level[LIT_VAR(learnt->items[k])] > level) {
+            level = s->level[LIT_VAR(learnt->items[k])];
+            pos = k;
+        }
+    }
+    if (learnt->len > 1) {
+        tmp = learnt->items[1];
+        learnt->items[1] = learnt->items[pos];
+        learnt->items[pos] = tmp;
+    }
+    return level;
+}
+
+static long luby(long i) {
+    // i-th term (from 1) of the sequence 1 1 2 1 1 2 4 1 1 2 ...
+    int k = 1;
+    for (;;) {
+        while ((1L << k) - 1 < i) {
+            k++;
+        }
+        if ((1L << k) - 1 == i) {
+            return 1L << (k - 1);
+        }
+        i -= (1L << (k - 1)) - 1;
+        k = 1;
+    }
+}
+
+static bool cdcl_search(t_cdcl* s) {
+    // true if all the cells are assigned without conflict
+    t_ivec learnt = {NULL, 0, 0};
+    long conflicts = 0;
+    long limit = RESTART_BASE;
+    int confl, level, v;
+    bool found;
+
+    for (;;) {
+        confl = propagate(s);
+        if (confl != NO_REASON) {
+            s->conflicts++;
+            conflicts++;
+            if (s->nb_levels == 0) {
+                found = false;
+                break;
+            }
+            level = analyze(s, confl, &learnt);
+            backtrack(s, level);
+            if (learnt.len == 1) {
+                assign(s, learnt.items[0], NO_REASON);
+            } else {
+                assign(s, learnt.items[0], add_clause(s, learnt.items, learnt.len));
+                s->nb_learnt++;
+            }
+            s->var_inc /= VAR_DECAY;
+            continue;
+        }
+
+        if (conflicts >= limit) {
+            backtrack(s, 0);
+            s->restarts++;
+            conflicts = 0;
+            limit = RESTART_BASE * luby(s->restarts + 1);
+        }
+
+        v = -1;
+        while (s->heap_len > 0 && v < 0) {
+            v = heap_pop(s);
+            if (s->value[v] >= 0) {
+                v = -1;
+            }
+        }
+        if (v < 0) {
+            found = true;
+            break;
+        }
+        s->decisions++;
+        new_level(s);
+        assign(s, LIT(v, s->phase[v]), NO_REASON);
+    }
+    free(learnt.items);
+    return found;
+}
+
+static void cdcl_init(t_cdcl* s, t_grid* g) {
+    int n = g->size;
+    int a, b, c;
+    int lits[3];
+
+    memset(s, 0, sizeof(t_cdcl));
+    s->n = n;
+    s->nb_vars = n * n;
+    s->value = (signed char*)cdcl_alloc(s->nb_vars);
+    s->phase = (signed char*)cdcl_alloc(s->nb_vars);
+    s->level = (int*)cdcl_alloc(sizeof(int) * s->nb_vars);
+    s->reason = (int*)cdcl_alloc(sizeof(int) * s->nb_vars);
+    s->seen = (bool*)cdcl_alloc(sizeof(bool) * s->nb_vars);
+    s->trail = (int*)cdcl_alloc(sizeof(int) * s->nb_vars);
+    s->trail_lim = (int*)cdcl_alloc(sizeof(int) * (s->nb_vars + 1));
+    s->arena_lim = (int*)cdcl_alloc(sizeof(int) * (s->nb_vars + 1));
+    s->watches = (t_ivec*)cdcl_alloc(sizeof(t_ivec) * 2 * s->nb_vars);
+    s->activity = (double*)cdcl_alloc(sizeof(double) * s->nb_vars);
+    s->heap = (int*)cdcl_alloc(sizeof(int) * s->nb_vars);
+    s->heap_pos = (int*)cdcl_alloc(sizeof(int) * s->nb_vars);
+    s->var_inc = 1;
+
+    for (int v = 0; v < s->nb_vars; v++) {
+        s->value[v] = -1;
+        s->heap_pos[v] = -1;
+        heap_insert(s, v);
+    }
+
+    // no 3 consecutive 1 / 0 in the windows of the rows and the columns
+    for (int k = 0; k < n; k++) {
+        for (int w = 0; w + 2 < n; w++) {
+            for (int is_row = 0; is_row < 2; is_row++) {
+                a = line_var(s, k, is_row, w);
+                b = line_var(s, k, is_row, w + 1);
+                c = line_var(s, k, is_row, w + 2);
+                for (int v = 0; v < 2; v++) {
+                    lits[0] = LIT(a, v);
+                    lits[1] = LIT(b, v);
+                    lits[2] = LIT(c, v);
+                    add_clause(s, lits, 3);
+                }
+            }
+        }
+    }
+
+    // the cells of the grid
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (g->grid[i][j] != '_') {
+                assign(s, LIT(i * n + j, g->grid[i][j] == '1'), NO_REASON);
+            }
+        }
+    }
+}
+
+static void cdcl_free(t_cdcl* s) {
+    free(s->value);
+    free(s->phase);
+    free(s->level);
+    free(s->reason);
+    free(s->seen);
+    free(s->trail);
+    free(s->trail_lim);
+    free(s->arena_lim);
+    for (int l = 0; l < 2 * s->nb_vars; l++) {
+        free(s->watches[l].items);
+    }
+    free(s->watches);
+    free(s->db.items);
+    free(s->arena.items);
+    free(s->activity);
+    free(s->heap);
+    free(s->heap_pos);
+}
+
+t_grid* find_solution_cdcl(t_grid* tosolve) {
+    /*
+    return a solution of tosolve (to free with grid_free and free) found by
+    the clause learning search, or NULL if there is no solution
+    */
+    t_cdcl s;
+    t_grid* sol = NULL;
+    int n = tosolve->size;
+
+    cdcl_init(&s, tosolve);
+    if (cdcl_search(&s)) {
+        sol = (t_grid*)malloc(sizeof(t_grid));
+        if (sol == NULL) {
+            perror("find_solution_cdcl");
+            exit(EXIT_FAILURE);
+        }
+        grid_copy(tosolve, sol);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (sol->grid[i][j] == '_') {
+                    set_cell(i, j, sol, s.value[i * n + j] ? '1' : '0');
+                }
+            }
+        }
+    }
+    stats.nodes += s.decisions;
+    stats.backtracks += s.conflicts;
+    stats.solutions += sol != NULL;
+    if (verbose) {
+        printf("verbose: cdcl: %ld conflicts, %ld decisions, %ld restarts, %d learnt clauses\n", s.conflicts, s.decisions, s.restarts, s.nb_learnt);
+    }
+    cdcl_free(&s);
+    return sol;
+}
@@ -0,0 +1,318 @@
+#include <err.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binary.h"
+#include "corpus.h"
+#include "grid.h"
+#include "utils.h"
+
+/*
+A corpus is a file with one or more grids. The size of a grid is the number
+of cells of its first line, its next lines are the rows. As in a grid file,
+the blank lines and the comments ('#' to the end of the line) are skipped,
+the cells are separated by ' ' or '\t'. The file is scanned in place.
+A file starting with BINARY_MAGIC is a binary file of grids (see binary.c).
+*/
+
+static void corpus_read(t_corpus* c, int fd) {
+    // a file which can't be mapped (a pipe...): read it whole
+    size_t cap = 1 << 16;
+    ssize_t nb;
+    char* buf = (char*)malloc(cap);
+
+    c->size = 0;
+    while (buf != NULL && (nb = read(fd, buf + c->size, cap - c->size)) > 0) {
+        c->size += nb;
+        if (c->size == cap) {
+            cap *= 2;
+            buf = (char*)realloc(buf, cap);
+        }
+    }
+    if (buf == NULL) {
+        perror("corpus_read");
+        exit(EXIT_FAILURE);
+    }
+    c->data = buf;
+    c->mapped = false;
+}
+
+static void binary_open(t_corpus* c) {
+    // check the header and the size of a binary file
+    size_t len;
+
+    if (!binary_header((const uint8_t*)c->data, c->size, &c->bin_size, &c->count)) {
+        corpus_close(c);
+        errx(EXIT_FAILURE, "error: %s: unknown binary format", c->name);
+    }
+    if (c->bin_size != 0 && !control_size_grid(c->bin_size)) {
+        corpus_close(c);
+        errx(EXIT_FAILURE, "error: %s: wrong grid size %d", c->name, c->bin_size);
+    }
+    len = c->bin_size != 0 ? binary_record_size(c->bin_size) : 1;
+    if ((c->size - BINARY_HEADER) % len != 0 || (c->count != 0 && (size_t)c->count != (c->size - BINARY_HEADER) / len)) {
+        corpus_close(c);
+        errx(EXIT_FAILURE, "error: %s: truncated binary file", c->name);
+    }
+    c->count = (c->size - BINARY_HEADER) / len;
+    c->next = 0;
+}
+
+void corpus_open(t_corpus* c, char* fname) {
+    struct stat st;
+    int fd = open(fname, O_RDONLY);
+
+    if (fd < 0) {
+        perror("error when opening the file");
+        exit(EXIT_FAILURE);
+    }
+    c->name = fname;
+    c->pos = 0;
+    c->line = 1;
+    c->grid_line = 0;
+
+    c->data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        c->size = st.st_size;
+        c->data = (const char*)mmap(NULL, c->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (c->data != MAP_FAILED) {
+        c->mapped = true;
+        madvise((void*)c->data, c->size, MADV_SEQUENTIAL);
+    } else {
+        corpus_read(c, fd);
+    }
+    close(fd);
+
+    if (c->size == 0) {
+        corpus_close(c);
+        errx(EXIT_FAILURE, "error: %s: empty file", fname);
+    }
+
+    c->binary = c->size >= 4 && memcmp(c->data, BINARY_MAGIC, 4) == 0;
+    if (c->binary) {
+        binary_open(c);
+    }
+}
+
+void corpus_close(t_corpus* c) {
+    if (c->mapped) {
+        munmap((void*)c->data, c->size);
+    } else {
+        free((void*)c->data);
+    }
+    c->data = NULL;
+    c->size = 0;
+}
+
+static const char* line_end(t_corpus* c) {
+    // end of the line at c->pos: its '\n' or the end of the file
+    const char* e = (const char*)memchr(c->data + c->pos, '\n', c->size - c->pos);
+    return e != NULL ? e : c->data + c->size;
+}
+
+static void line_next(t_corpus* c, const char* e) {
+    c->pos = e - c->data + (e < c->data + c->size);
+    c->line++;
+}
+
+static bool line_blank(const char* s, const char* e) {
+    // only separators before the comment
+    for (; s < e && *s != '#'; s++) {
+        if (*s != ' ' && *s != '\t') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int line_cells(const char* s, const char* e) {
+    // number of cells before the comment, the other characters are not checked
+    int cpt = 0;
+    for (; s < e && *s != '#'; s++) {
+        cpt += *s == '0' || *s == '1' || *s == '_';
+    }
+    return cpt;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static inline uint64_t lanes_equal(uint64_t cells, char v) {
+    // bit 15 of each 16 bits lane: its low byte is v (the lanes are below 0x100, no carry between them)
+    return ~((cells ^ (0x0001000100010001ULL * (unsigned char)v)) + 0x7FFF7FFF7FFF7FFFULL) & 0x8000800080008000ULL;
+}
+
+static inline uint64_t lanes_gather(uint64_t x) {
+    // bits 15, 31, 47 and 63 to the bits 0 to 3
+    return ((x >> 15) & 1) | ((x >> 30) & 2) | ((x >> 45) & 4) | ((x >> 60) & 8);
+}
+
+static bool row_fast(const char* s, const char* e, const char* end, int n, uint64_t* filled, uint64_t* ones) {
+    /*
+    the common layout, n cells separated by one space from the start of the line,
+    is read 8 bytes (4 cells and their spaces) at once. Return false if the line
+    is not in this layout, it is then read by row_scan.
+    */
+    uint64_t w, cells, is0, is1, isE;
+    uint64_t sep = 0xFF00FF00FF00FF00ULL;
+    uint64_t f = 0;
+    uint64_t o = 0;
+
+    if (e - s < 2 * n - 1 || end - s < 2 * n) {
+        return false;
+    }
+    for (int k = 0; k < n / 4; k++) {
+        memcpy(&w, s + 8 * k, sizeof(w));
+        if (k == n / 4 - 1) {
+            sep = 0x0000FF00FF00FF00ULL; // the byte after the last cell is checked below
+        }
+        if ((w & sep) != (0x2000200020002000ULL & sep)) {
+            return false;
+        }
+        cells = w & 0x00FF00FF00FF00FFULL;
+        is0 = lanes_equal(cells, '0');
+        is1 = lanes_equal(cells, '1');
+        isE = lanes_equal(cells, '_');
+        if ((is0 | is1 | isE) != 0x8000800080008000ULL) {
+            return false;
+        }
+        f |= lanes_gather(is0 | is1) << (4 * k);
+        o |= lanes_gather(is1) << (4 * k);
+    }
+    if (!line_blank(s + 2 * n - 1, e)) {
+        return false;
+    }
+    *filled = f;
+    *ones = o;
+    return true;
+}
+#else
+static bool row_fast(const char* s, const char* e, const char* end, int n, uint64_t* filled, uint64_t* ones) {
+    (void)s, (void)e, (void)end, (void)n, (void)filled, (void)ones;
+    return false;
+}
+#endif
+
+static void row_scan(t_corpus* c, t_grid* g, const char* s, const char* e, uint64_t* filled, uint64_t* ones) {
+    // any layout of the row of the line c->line, exit with an error if it is not a row of g
+    int n = g->size;
+    int j = 0;
+    char wrong;
+
+    *filled = 0;
+    *ones = 0;
+    for (; s < e && *s != '#'; s++) {
+        if (*s == '0' || *s == '1' || *s == '_') {
+            if (j >= n) {
+                grid_free(g);
+                errx(EXIT_FAILURE, "error: %s: line %d is malformed", c->name, c->line);
+            }
+            *filled |= (uint64_t)(*s != '_') << j;
+            *ones |= (uint64_t)(*s == '1') << j;
+            j++;
+        } else if (*s != ' ' && *s != '\t') {
+            wrong = *s;
+            grid_free(g);
+            errx(EXIT_FAILURE, "error: %s: wrong character '%c' at line %d", c->name, wrong, c->line);
+        }
+    }
+    if (j < n) {
+        grid_free(g);
+        errx(EXIT_FAILURE, "error: %s: line %d is malformed", c->name, c->line);
+    }
+}
+
+bool corpus_end(t_corpus* c) {
+    // skip the blank lines, true if there is no grid left
+    const char* e;
+    if (c->binary) {
+        return c->next >= c->count;
+    }
+    while (c->pos < c->size && line_blank(c->data + c->pos, e = line_end(c))) {
+        line_next(c, e);
+    }
+    return c->pos >= c->size;
+}
+
+bool corpus_next(t_corpus* c, t_grid* g) {
+    /*
+    read the next grid of the corpus in g (allocated here), return false if
+    there is none. Exit with an error (and its line) if the grid is malformed.
+    */
+    const char* end = c->data + c->size;
+    const char* s;
+    const char* e;
+    uint64_t filled, ones;
+    int n;
+
+    if (corpus_end(c)) {
+        return false;
+    }
+    if (c->binary) {
+        grid_allocate(g, c->bin_size);
+        binary_load(g, (const uint8_t*)c->data + BINARY_HEADER + c->next * binary_record_size(c->bin_size));
+        c->grid_line = ++c->next;
+        return true;
+    }
+    s = c->data + c->pos;
+    e = line_end(c);
+    n = line_cells(s, e);
+    if (!control_size_grid(n)) {
+        errx(EXIT_FAILURE, "error: %s: line %d is malformed", c->name, c->line);
+    }
+    grid_allocate(g, n);
+    c->grid_line = c->line;
+
+    for (int i = 0; i < n; i++) {
+        if (corpus_end(c)) {
+            grid_free(g);
+            errx(EXIT_FAILURE, "error: %s: grid of line %d has %d missing line(s)!", c->name, c->grid_line, n - i);
+        }
+        s = c->data + c->pos;
+        e = line_end(c);
+        if (!row_fast(s, e, end, n, &filled, &ones)) {
+            row_scan(c, g, s, e, &filled, &ones);
+        }
+
+        // the cells are empty after grid_allocate, only the filled ones are written
+        load_row(i, g, filled, ones);
+        line_next(c, e);
+    }
+    load_done(g);
+    return true;
+}
+
+bool corpus_seek(t_corpus* c, long k) {
+    /*
+    go to the grid k (from 0) of the corpus, return false if there are not so
+    many grids. Constant time in a binary file, the text is scanned from the
+    start: only the first line of each grid is read (for its size).
+    */
+    int n;
+
+    if (c->binary) {
+        c->next = k;
+        return k >= 0 && k < c->count;
+    }
+    c->pos = 0;
+    c->line = 1;
+    for (long cpt = 0; cpt < k; cpt++) {
+        if (corpus_end(c)) {
+            return false;
+        }
+        n = line_cells(c->data + c->pos, line_end(c));
+        for (int i = 0; i < n; i++) {
+            if (corpus_end(c)) {
+                return false;
+            }
+            line_next(c, line_end(c));
+        }
+    }
+    return !corpus_end(c);
+}
@@ -2,12 +2,20 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "bitboard.h"
 #include "euristic.h"
 #include "grid.h"
+#include "parity.h"
+#include "pattern.h"
+#include "pool.h"
+#include "stats.h"
 
 extern bool verbose;
 
+t_propagation propagation = PROPAGATE_BASIC;
+
 char reverse(const char c) {
     if (c == '1') {
         return '0';
@@ -18,219 +26,536 @@ char reverse(const char c) {
     }
 }
 
-static bool euri_consec_line(t_grid* g) {
-    // when there are 2 consecutive 0 (resp. 1), the next/previous cell is a 1 (resp. 0) (for lines)
-    unsigned int n = g->size;
-    bool change = false;
-    for (unsigned int i = 0; i < n; i++) {
+static int fill_row(t_grid* g, int i, uint64_t to_one, uint64_t to_zero) {
+    // set the empty cells of to_one (resp. to_zero) of the line i to 1 (resp. 0), return their number
+    // a cell forced both ways is set to 1, the conflict is caught by is_consistent
+    to_one &= ~g->row_filled[i];
+    to_zero &= ~(g->row_filled[i] | to_one);
+    int nb = line_count(to_one | to_zero);
+    for (; to_one; to_one &= to_one - 1) {
+        set_cell(i, __builtin_ctzll(to_one), g, '1');
+    }
+    for (; to_zero; to_zero &= to_zero - 1) {
+        set_cell(i, __builtin_ctzll(to_zero), g, '0');
+    }
+    return nb;
+}
 
-        // left border, case [x x _ ...]
-        if (g->grid[i][2] == '_' && g->grid[i][0] != '_' && g->grid[i][0] == g->grid[i][1]) {
-            set_cell(i, 2, g, reverse(g->grid[i][1]));
-            change = true;
-        }
+static int fill_col(t_grid* g, int j, uint64_t to_one, uint64_t to_zero) {
+    // same as fill_row for the column j
+    to_one &= ~g->col_filled[j];
+    to_zero &= ~(g->col_filled[j] | to_one);
+    int nb = line_count(to_one | to_zero);
+    for (; to_one; to_one &= to_one - 1) {
+        set_cell(__builtin_ctzll(to_one), j, g, '1');
+    }
+    for (; to_zero; to_zero &= to_zero - 1) {
+        set_cell(__builtin_ctzll(to_zero), j, g, '0');
+    }
+    return nb;
+}
 
-        // right border, case [... _ x x]
-        if (g->grid[i][n - 3] == '_' && g->grid[i][n - 1] != '_' && g->grid[i][n - 1] == g->grid[i][n - 2]) {
-            set_cell(i, n - 3, g, reverse(g->grid[i][n - 2]));
-            change = true;
+static bool euri_consec_line(t_grid* g, int i) {
+    // when there are 2 consecutive 0 (resp. 1), the next/previous cell is a 1 (resp. 0) (for the line i)
+    uint64_t empty = line_full_mask(g->size) & ~g->row_filled[i];
+
+    // case [... _ x x _ ...], borders included
+    uint64_t to_one = line_pairs_border(line_zeros(g->row_filled[i], g->row_ones[i])) & empty;
+    uint64_t to_zero = line_pairs_border(g->row_ones[i]) & empty;
+    if (!(to_one | to_zero)) {
+        return false;
+    }
+    stats.forced[RULE_CONSEC] += fill_row(g, i, to_one, to_zero);
+    if (verbose) {
+        printf("verbose: euri_consec_line: applied on line %u\n", i);
+    }
+    return true;
+}
+
+static bool euri_consec_col(t_grid* g, int j) {
+    // when there are 2 consecutive 0 (resp. 1), the next/previous cell is a 1 (resp. 0) (for the column j)
+    uint64_t empty = line_full_mask(g->size) & ~g->col_filled[j];
+
+    // case [... _ x x _ ...], borders included
+    uint64_t to_one = line_pairs_border(line_zeros(g->col_filled[j], g->col_ones[j])) & empty;
+    uint64_t to_zero = line_pairs_border(g->col_ones[j]) & empty;
+    if (!(to_one | to_zero)) {
+        return false;
+    }
+    stats.forced[RULE_CONSEC] += fill_col(g, j, to_one, to_zero);
+    if (verbose) {
+        printf("verbose: euri_consec_col: applied on column %u\n", j);
+    }
+    return true;
+}
+
+static bool euri_complete_line(t_grid* g, int i) {
+    // if the amount of 0 (resp. 1) of the line i is here, fill the rest by 1 (resp. 0)
+    int n = g->size;
+    uint64_t empty = line_full_mask(n) & ~g->row_filled[i];
+
+    if (!empty) {
+        return false;
+    }
+    if (line_count(line_zeros(g->row_filled[i], g->row_ones[i])) == n / 2) {
+        stats.forced[RULE_COMPLETE] += fill_row(g, i, empty, 0);
+    } else if (line_count(g->row_ones[i]) == n / 2) {
+        stats.forced[RULE_COMPLETE] += fill_row(g, i, 0, empty);
+    } else {
+        return false;
+    }
+    if (verbose) {
+        printf("verbose: euri_complete_line: filling line %u\n", i);
+    }
+    return true;
+}
+
+static bool euri_complete_col(t_grid* g, int j) {
+    // if the amount of 0 (resp. 1) of the column j is here, fill the rest by 1 (resp. 0)
+    int n = g->size;
+    uint64_t empty = line_full_mask(n) & ~g->col_filled[j];
+
+    if (!empty) {
+        return false;
+    }
+    if (line_count(line_zeros(g->col_filled[j], g->col_ones[j])) == n / 2) {
+        stats.forced[RULE_COMPLETE] += fill_col(g, j, empty, 0);
+    } else if (line_count(g->col_ones[j]) == n / 2) {
+        stats.forced[RULE_COMPLETE] += fill_col(g, j, 0, empty);
+    } else {
+        return false;
+    }
+    if (verbose) {
+        printf("verbose: euri_complete_column: filling column %u\n", j);
+    }
+    return true;
+}
+
+static bool euri_middle_line(t_grid* g, int i) {
+    /* This euristic treat this type of situation [... 0 _ 0 ...]
+        In this case, we know that _ is a 1
+    */
+    uint64_t empty = line_full_mask(g->size) & ~g->row_filled[i];
+    uint64_t to_one = line_pairs_middle(line_zeros(g->row_filled[i], g->row_ones[i])) & empty;
+    uint64_t to_zero = line_pairs_middle(g->row_ones[i]) & empty;
+
+    if (!(to_one | to_zero)) {
+        return false;
+    }
+    stats.forced[RULE_MIDDLE] += fill_row(g, i, to_one, to_zero);
+    if (verbose) {
+        printf("verbose: middle_one: applied on line %u\n", i);
+    }
+    return true;
+}
+
+static bool euri_middle_col(t_grid* g, int j) {
+    // same as euri_middle_line for the column j
+    uint64_t empty = line_full_mask(g->size) & ~g->col_filled[j];
+    uint64_t to_one = line_pairs_middle(line_zeros(g->col_filled[j], g->col_ones[j])) & empty;
+    uint64_t to_zero = line_pairs_middle(g->col_ones[j]) & empty;
+
+    if (!(to_one | to_zero)) {
+        return false;
+    }
+    stats.forced[RULE_MIDDLE] += fill_col(g, j, to_one, to_zero);
+    if (verbose) {
+        printf("verbose: middle_one: applied on column %u\n", j);
+    }
+    return true;
+}
+
+static bool euri_patterns_line(t_grid* g, int i) {
+    // the empty cells of the line i with the same value in all its valid patterns left
+    uint64_t to_one, to_zero;
+
+    if (!pattern_forced(g, i, true, &to_one, &to_zero)) {
+        g->conflict = true;
+        if (verbose) {
+            printf("verbose: euri_patterns_line: no valid pattern left for line %u\n", i);
         }
+        return false;
+    }
+    if (!(to_one | to_zero)) {
+        return false;
+    }
+    stats.forced[RULE_PATTERNS] += fill_row(g, i, to_one, to_zero);
+    if (verbose) {
+        printf("verbose: euri_patterns_line: applied on line %u\n", i);
+    }
+    return true;
+}
 
-        // middle, case [... _ x x _ ...]
-        for (unsigned int j = 1; j < n - 2; j++) {
-            if (g->grid[i][j] != '_' && g->grid[i][j] == g->grid[i][j + 1]) {
-                if (g->grid[i][j - 1] == '_') {
-                    set_cell(i, j - 1, g, reverse(g->grid[i][j]));
-                    change = true;
-                }
-                if (g->grid[i][j + 2] == '_') {
-                    set_cell(i, j + 2, g, reverse(g->grid[i][j]));
-                    change = true;
-                }
-            }
+static bool euri_patterns_col(t_grid* g, int j) {
+    // same as euri_patterns_line for the column j
+    uint64_t to_one, to_zero;
+
+    if (!pattern_forced(g, j, false, &to_one, &to_zero)) {
+        g->conflict = true;
+        if (verbose) {
+            printf("verbose: euri_patterns_col: no valid pattern left for column %u\n", j);
         }
+        return false;
     }
-    if (change && verbose) {
-        printf("verbose: euri_consec_line: applied\n");
+    if (!(to_one | to_zero)) {
+        return false;
     }
-    return change;
+    stats.forced[RULE_PATTERNS] += fill_col(g, j, to_one, to_zero);
+    if (verbose) {
+        printf("verbose: euri_patterns_col: applied on column %u\n", j);
+    }
+    return true;
 }
 
-static bool euri_consec_col(t_grid* g) {
-    // when there are 2 consecutive 0 (resp. 1), the next/previous cell is a 1 (resp. 0) (for columns)
-    unsigned int n = g->size;
+static int line_cell(t_grid* g, int k, bool is_row, int p) {
+    // index (i * size + j) of the cell p of the line k
+    return is_row ? k * g->size + p : p * g->size + k;
+}
+
+static bool parity_spread(t_grid* g, int c) {
+    // give the value of the assigned cell c to the empty cells of its class, g->conflict if one disagrees
+    int n = g->size;
+    char v = g->grid[c / n][c % n];
+    int pc, pm;
+    char w;
     bool change = false;
-    for (unsigned int j = 0; j < n; j++) {
 
-        // top border, case [x x _ ...]
-        if (g->grid[2][j] == '_' && g->grid[0][j] != '_' && g->grid[0][j] == g->grid[1][j]) {
-            set_cell(2, j, g, reverse(g->grid[1][j]));
+    parity_find(g, c, &pc);
+    for (int m = g->parity->next[c]; m != c; m = g->parity->next[m]) {
+        parity_find(g, m, &pm);
+        w = (pc ^ pm) ? reverse(v) : v;
+        if (g->grid[m / n][m % n] == '_') {
+            set_cell(m / n, m % n, g, w);
+            stats.forced[RULE_PARITY]++;
             change = true;
+        } else if (g->grid[m / n][m % n] != w) {
+            g->conflict = true;
+            return change;
         }
+    }
+    return change;
+}
 
-        // bottom border, case [... _ x x]
-        if (g->grid[n - 3][j] == '_' && g->grid[n - 1][j] != '_' && g->grid[n - 1][j] == g->grid[n - 2][j]) {
-            set_cell(n - 3, j, g, reverse(g->grid[n - 2][j]));
-            change = true;
+static int parity_relate(t_grid* g, int a, int b, int differ) {
+    // link the empty cells a and b, g->conflict if they were linked the other way
+    int res = parity_link(g, a, b, differ);
+
+    if (res < 0) {
+        g->conflict = true;
+    }
+    return res;
+}
+
+static bool parity_same(t_grid* g, int a, int b) {
+    // the cells a and b are known to be equal
+    int pa, pb;
+    return parity_find(g, a, &pa) == parity_find(g, b, &pb) && pa == pb;
+}
+
+static bool euri_parity(t_grid* g, int k, bool is_row) {
+    /*
+    equal / opposite relations between the empty cells of the line k (parity.c):
+        [... x _ _ !x ...]        the two empty cells are opposite
+        two empty cells left      opposite if the line needs one 0 and one 1
+        [... _ a b _ ...], a = b  the neighbours are opposite to a (set if assigned)
+        [... a _ b ...], a = b    the middle cell is opposite to a (set if assigned)
+    the assigned cells of the line give their value to all the cells of their class
+    */
+    int n = g->size;
+    uint64_t full = line_full_mask(n);
+    uint64_t filled = is_row ? g->row_filled[k] : g->col_filled[k];
+    uint64_t linked;
+    uint64_t ones, zeros, empty, m;
+    int p, c, q, links = 0;
+    bool change = false;
+
+    // the classes of a grid are set up by its first use of the rule
+    if (g->parity == NULL) {
+        pool_parity(g);
+    }
+    linked = is_row ? g->parity->row_linked[k] : g->parity->col_linked[k];
+
+    for (m = filled & linked; m; m &= m - 1) {
+        change = parity_spread(g, line_cell(g, k, is_row, __builtin_ctzll(m))) | change;
+        if (g->conflict) {
+            return change;
         }
+    }
+
+    filled = is_row ? g->row_filled[k] : g->col_filled[k];
+    ones = is_row ? g->row_ones[k] : g->col_ones[k];
+    zeros = line_zeros(filled, ones);
+    empty = full & ~filled;
+    linked &= empty;
+
+    m = empty & (empty >> 1) & (((ones << 1) & (zeros >> 2)) | ((zeros << 1) & (ones >> 2)));
+    for (; m; m &= m - 1) {
+        p = __builtin_ctzll(m);
+        links += parity_relate(g, line_cell(g, k, is_row, p), line_cell(g, k, is_row, p + 1), 1);
+    }
+    if (line_count(empty) == 2 && line_count(ones) == n / 2 - 1) {
+        p = __builtin_ctzll(empty);
+        q = 63 - __builtin_clzll(empty);
+        links += parity_relate(g, line_cell(g, k, is_row, p), line_cell(g, k, is_row, q), 1);
+    }
 
-        // middle, case [... _ x x _ ...]
-        for (unsigned int i = 1; i < n - 2; i++) {
-            if (g->grid[i][j] != '_' && g->grid[i][j] == g->grid[i + 1][j]) {
-                if (g->grid[i - 1][j] == '_') {
-                    set_cell(i - 1, j, g, reverse(g->grid[i][j]));
-                    change = true;
+    // only the empty cells in a class of several cells can be equal to a neighbour
+    for (m = linked & ((linked >> 1) | (linked >> 2)); m && !g->conflict; m &= m - 1) {
+        p = __builtin_ctzll(m);
+        c = line_cell(g, k, is_row, p);
+        for (int d = 1; d <= 2; d++) {
+            if (!(linked >> (p + d) & 1) || !parity_same(g, c, line_cell(g, k, is_row, p + d))) {
+                continue;
+            }
+            // cells opposite to c: p - 1 and p + 2 if d = 1, p + 1 if d = 2
+            for (q = (d == 1 ? p - 1 : p + 1); q <= p + 2 && !g->conflict; q += 3) {
+                if (q < 0 || q >= n) {
+                    continue;
                 }
-                if (g->grid[i + 2][j] == '_') {
-                    set_cell(i + 2, j, g, reverse(g->grid[i][j]));
-                    change = true;
+                if (empty >> q & 1) {
+                    links += parity_relate(g, line_cell(g, k, is_row, q), c, 1);
+                } else {
+                    // the line is in the queue again with the new cell
+                    set_cell(c / n, c % n, g, (ones >> q & 1) ? '0' : '1');
+                    stats.forced[RULE_PARITY]++;
+                    return true;
                 }
             }
         }
     }
-    if (change && verbose) {
-        printf("verbose: euri_consec_col: applied\n");
+
+    if (g->conflict) {
+        if (verbose) {
+            printf("verbose: euri_parity: contradiction on %s %u\n", is_row ? "line" : "column", k);
+        }
+        return change;
     }
-    return change;
+    if (links > 0 && verbose) {
+        printf("verbose: euri_parity: %d links on %s %u\n", links, is_row ? "line" : "column", k);
+    }
+    return change || links > 0;
 }
 
-static bool euri_complete_line(t_grid* g) {
-    // for each line, if the amount of 0 (resp. 1) is here, fill the rest by 1 (resp. 0)
-    unsigned int count0;
-    unsigned int count1;
-    unsigned int n = g->size;
-    char fill_with;
-    bool fill;
+static bool euri_windows_all(t_grid* g) {
+    /*
+    the consecutive and middle rules on all the rows, then all the columns,
+    with the vectorized kernel of bitboard.c. The masks of the columns are
+    computed after the rows are filled, the cells already set are skipped.
+    */
+    int n = g->size;
+    uint64_t full = line_full_mask(n);
+    uint64_t to_one[MAX_GRID_SIZE];
+    uint64_t to_zero[MAX_GRID_SIZE];
     bool change = false;
 
-    for (unsigned int i = 0; i < n; i++) {
-        fill = false;
-        count0 = 0;
-        count1 = 0;
-        for (unsigned int j = 0; j < n; j++) {
-            if (g->grid[i][j] == '1') {
-                count1++;
-            } else if (g->grid[i][j] == '0') {
-                count0++;
-            }
+    lines_forced(g->row_filled, g->row_ones, n, full, to_one, to_zero);
+    for (int i = 0; i < n; i++) {
+        if (to_one[i] | to_zero[i]) {
+            stats.forced[RULE_WINDOWS] += fill_row(g, i, to_one[i], to_zero[i]);
+            change = true;
         }
+    }
 
-        //printf("count0 = %d \n count1 = %d \n", count0, count1);
-
-        if (count0 == n / 2) {
-            fill_with = '1';
-            fill = true;
-        } else if (count1 == n / 2) {
-            fill_with = '0';
-            fill = true;
+    lines_forced(g->col_filled, g->col_ones, n, full, to_one, to_zero);
+    for (int j = 0; j < n; j++) {
+        if (to_one[j] | to_zero[j]) {
+            stats.forced[RULE_WINDOWS] += fill_col(g, j, to_one[j], to_zero[j]);
+            change = true;
         }
+    }
 
-        if (fill) {
-            for (unsigned int j = 0; j < n; j++) {
-                if (g->grid[i][j] == '_') {
-                    change = true;
-                    set_cell(i, j, g, fill_with);
-                }
-            }
-            if (verbose && change) {
-                printf("verbose: euri_complete_line: filling line %u\n", i);
-            }
-        }
+    if (change && verbose) {
+        printf("verbose: euri_windows_all: applied\n");
     }
     return change;
 }
 
-static bool euri_complete_col(t_grid* g) {
-    // for each line, if the amount of 0 (resp. 1) is here, fill the rest by 1 (resp. 0)
-    unsigned int count0;
-    unsigned int count1;
-    unsigned int n = g->size;
-    char fill_with;
-    bool fill;
-    bool change = false;
-
-    for (unsigned int j = 0; j < n; j++) {
-        fill = false;
-        count0 = 0;
-        count1 = 0;
-        for (unsigned int i = 0; i < n; i++) {
-            if (g->grid[i][j] == '1') {
-                count1++;
-            } else if (g->grid[i][j] == '0') {
-                count0++;
-            }
+static void conflict_weigh(t_grid* g, int k, bool on_row) {
+    // the broken lines and the last visited line k get the dead end, for the activity branching
+    g->line_dirty_rows |= g->row_bad;
+    g->line_dirty_cols |= g->col_bad;
+    for (uint64_t m = g->row_bad; m; m &= m - 1) {
+        g->row_weight[__builtin_ctzll(m)]++;
+    }
+    for (uint64_t m = g->col_bad; m; m &= m - 1) {
+        g->col_weight[__builtin_ctzll(m)]++;
+    }
+    if (k >= 0) {
+        if (on_row) {
+            g->row_weight[k]++;
+            g->line_dirty_rows |= 1ULL << k;
+        } else {
+            g->col_weight[k]++;
+            g->line_dirty_cols |= 1ULL << k;
         }
+    }
+}
 
-        //printf("count0 = %d \n count1 = %d \n", count0, count1);
+static bool euristics_queue(t_grid* g, bool weigh) {
+    /*
+    set_cell puts the row and the column of each assigned cell in the queue
+    (dirty_rows / dirty_cols), only the lines of the queue are visited by the
+    rules, until the queue is empty or the grid is not consistent anymore.
+    A dead end weighs its lines if weigh is true.
+    */
+    bool change = false;
+    int k = -1;
+    bool on_row = true;
 
-        if (count0 == n / 2) {
-            fill_with = '1';
-            fill = true;
-        } else if (count1 == n / 2) {
-            fill_with = '0';
-            fill = true;
-        }
+    // many lines in the queue (a new grid): one vectorized pass on the whole grid first
+    if (is_consistent(g) && line_count(g->dirty_rows) + line_count(g->dirty_cols) >= g->size) {
+        change = euri_windows_all(g);
+    }
 
-        if (fill) {
-            for (unsigned int i = 0; i < n; i++) {
-                if (g->grid[i][j] == '_') {
-                    change = true;
-                    set_cell(i, j, g, fill_with);
-                }
+    while (is_consistent(g) && (g->dirty_rows | g->dirty_cols)) {
+        if (g->dirty_rows) {
+            k = __builtin_ctzll(g->dirty_rows);
+            on_row = true;
+            g->dirty_rows &= g->dirty_rows - 1;
+            change = euri_consec_line(g, k) | change;
+            change = euri_middle_line(g, k) | change;
+            change = euri_complete_line(g, k) | change;
+            if (propagation >= PROPAGATE_PARITY && is_consistent(g)) {
+                change = euri_parity(g, k, true) | change;
+            }
+            if (is_consistent(g)) {
+                change = euri_patterns_line(g, k) | change;
+            }
+        } else {
+            k = __builtin_ctzll(g->dirty_cols);
+            on_row = false;
+            g->dirty_cols &= g->dirty_cols - 1;
+            change = euri_consec_col(g, k) | change;
+            change = euri_middle_col(g, k) | change;
+            change = euri_complete_col(g, k) | change;
+            if (propagation >= PROPAGATE_PARITY && is_consistent(g)) {
+                change = euri_parity(g, k, false) | change;
             }
-            if (verbose && change) {
-                printf("verbose: euri_complete_column: filling column %u\n", j);
+            if (is_consistent(g)) {
+                change = euri_patterns_col(g, k) | change;
             }
         }
     }
+
+    // a dead end: the grid will be undone to a state without pending lines
+    if (!is_consistent(g)) {
+        g->dirty_rows = 0;
+        g->dirty_cols = 0;
+        if (weigh) {
+            conflict_weigh(g, k, on_row);
+        }
+    }
     return change;
 }
 
-static bool euri_middle_one(t_grid* g) {
-    /* This euristic treat this type of situation [... 0 _ 0 ...]
-        In this case, we know that _ is a 1
-        Same principle for the column
-    */
+bool apply_euristics(t_grid* g) {
+    return euristics_queue(g, true);
+}
+
+static bool probe_value(t_grid* g, int i, int j, char v, uint64_t* filled, uint64_t* ones) {
+    // set the cell (i, j) to v and apply the euristics, false if the grid becomes inconsistent
+    // else the rows are saved in filled / ones, the grid is given back as it was
+    // with its changes: the probes leave the cache valid
+    int mark = grid_trail_mark(g);
+    uint64_t changes = g->changes;
+    bool ok;
 
-    unsigned int n = g->size;
+    // a failed probe is not a dead end of the search: the lines are not weighed
+    set_cell(i, j, g, v);
+    euristics_queue(g, false);
+    ok = is_consistent(g);
+    if (ok) {
+        memcpy(filled, g->row_filled, sizeof(uint64_t) * g->size);
+        memcpy(ones, g->row_ones, sizeof(uint64_t) * g->size);
+    }
+    grid_undo(g, mark);
+    g->changes = changes;
+    return ok;
+}
+
+static bool probe_cell(t_grid* g, int i, int j) {
+    /*
+    failed literal: if a value of the empty cell (i, j) makes the grid
+    inconsistent, the cell gets the other one (g->conflict is set if both fail).
+    Lookahead: the empty cells with the same value after both probes get it.
+    Return true if a cell is set.
+    */
+    int n = g->size;
+    uint64_t filled0[MAX_GRID_SIZE], ones0[MAX_GRID_SIZE];
+    uint64_t filled1[MAX_GRID_SIZE], ones1[MAX_GRID_SIZE];
+    uint64_t common;
+    bool ok0 = probe_value(g, i, j, '0', filled0, ones0);
+    bool ok1 = probe_value(g, i, j, '1', filled1, ones1);
     bool change = false;
 
-    for (unsigned int i = 0; i < n; i++) {
-        for (unsigned int j = 1; j < n - 1; j++) {
-            if (g->grid[i][j - 1] != '_' && g->grid[i][j - 1] == g->grid[i][j + 1] && g->grid[i][j] == '_') {
-                change = true;
-                set_cell(i, j, g, reverse(g->grid[i][j - 1]));
-            }
+    if (!ok0 && !ok1) {
+        g->conflict = true;
+        return false;
+    }
+    if (!ok0 || !ok1) {
+        if (verbose) {
+            printf("verbose: probe: cell (%d, %d) set to %c\n", i, j, ok0 ? '0' : '1');
         }
+        set_cell(i, j, g, ok0 ? '0' : '1');
+        stats.forced[RULE_PROBE]++;
+        return true;
     }
 
-    for (unsigned int j = 0; j < n; j++) {
-        for (unsigned int i = 1; i < n - 1; i++) {
-            if (g->grid[i - 1][j] != '_' && g->grid[i - 1][j] == g->grid[i + 1][j] && g->grid[i][j] == '_') {
-                change = true;
-                set_cell(i, j, g, reverse(g->grid[i - 1][j]));
-            }
+    for (int k = 0; k < n; k++) {
+        common = filled0[k] & filled1[k] & ~(ones0[k] ^ ones1[k]) & ~g->row_filled[k];
+        if (common) {
+            stats.forced[RULE_PROBE] += fill_row(g, k, common & ones0[k], common & ~ones0[k]);
+            change = true;
         }
     }
-
-    if (verbose && change) {
-        printf("verbose: middle_one: applied\n");
+    if (change && verbose) {
+        printf("verbose: probe: cells set by both values of cell (%d, %d)\n", i, j);
     }
     return change;
 }
 
-bool apply_euristics(t_grid* g) {
-    bool applied = true;
+static bool apply_probing(t_grid* g) {
+    /*
+    probe the empty cells until none of them sets a cell, the euristics are
+    applied after each cell set. A cell is not probed again while the grid
+    is the same as when its last probe found nothing (same changes): the result
+    of a probe depends on the whole grid.
+    */
+    int n = g->size;
+    uint64_t empty;
     bool change = false;
+    bool progress = true;
+    int j;
+
+    while (progress) {
+        progress = false;
+        for (int i = 0; i < n; i++) {
+            empty = line_full_mask(n) & ~g->row_filled[i];
+            for (; empty; empty &= empty - 1) {
+                j = __builtin_ctzll(empty);
+                if (!is_consistent(g) || is_valid(g)) {
+                    return change;
+                }
+                if (g->grid[i][j] != '_' || g->probe_key[i * n + j] == g->changes) {
+                    continue;
+                }
+                if (probe_cell(g, i, j)) {
+                    apply_euristics(g);
+                    change = progress = true;
+                } else {
+                    g->probe_key[i * n + j] = g->changes;
+                }
+            }
+        }
+    }
+    return change;
+}
 
-    while (is_consistent(g) && applied) {
-        applied = euri_consec_line(g);
-        applied = euri_consec_col(g) | applied;
-        applied = euri_complete_col(g) | applied;
-        applied = euri_complete_line(g) | applied;
-        applied = euri_consec_line(g) | applied;
-        applied = euri_middle_one(g) | applied;
-        change = applied | change;
+bool apply_propagation(t_grid* g) {
+    // the euristics, then the probing of the empty cells if propagation is PROPAGATE_PROBE
+    bool change = apply_euristics(g);
+    if (propagation == PROPAGATE_PROBE && is_consistent(g) && !is_valid(g)) {
+        change = apply_probing(g) | change;
     }
     return change;
-}
\ No newline at end of file
+}
@@ -0,0 +1,308 @@
+#include <err.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backtracking.h"
+#include "bitboard.h"
+#include "euristic.h"
+#include "generator.h"
+#include "grid.h"
+#include "stats.h"
+
+#define SAMPLE_TRIES 16L // swaps tried by generate_full per cell of the grid
+
+long dig_budget = 0;
+
+static void budget_search(t_grid* g, t_strategy* strategy, bool* found, long* budget) {
+    /*
+    look for a solution with at most *budget branches, *budget is negative at
+    the end if the search was stopped. g is given back as it was.
+    */
+    if (*found || *budget < 0) {
+        return;
+    }
+    if (!is_consistent(g)) {
+        stats.backtracks++;
+        return;
+    }
+    stats.nodes++;
+    if (is_valid(g)) {
+        *found = true;
+        return;
+    }
+
+    int mark = grid_trail_mark(g);
+    apply_euristics(g);
+
+    if (!is_consistent(g) || is_valid(g)) {
+        budget_search(g, strategy, found, budget);
+        grid_undo(g, mark);
+        return;
+    }
+
+    (*budget)--;
+    choice_t choice = grid_choice_strategy(g, strategy);
+    int branch = grid_trail_mark(g);
+
+    set_cell(choice.row, choice.column, g, choice.choice);
+    budget_search(g, strategy, found, budget);
+    grid_undo(g, branch);
+
+    choice.choice = choice.choice == '0' ? '1' : '0';
+    set_cell(choice.row, choice.column, g, choice.choice);
+    budget_search(g, strategy, found, budget);
+    grid_undo(g, mark);
+}
+
+typedef struct {
+    int size;
+    uint64_t rows[MAX_GRID_SIZE]; // bit j of row i: cell (i, j) is '1'
+    uint64_t cols[MAX_GRID_SIZE]; // bit i of column j: cell (i, j) is '1'
+} t_sampler;
+
+static bool line_ok(uint64_t ones, uint64_t full) {
+    return !line_triples(ones) && !line_triples(~ones & full);
+}
+
+static void sample_swap(t_sampler* s, int i1, int i2, int j1, int j2) {
+    uint64_t r = (1ULL << j1) | (1ULL << j2);
+    uint64_t c = (1ULL << i1) | (1ULL << i2);
+    s->rows[i1] ^= r;
+    s->rows[i2] ^= r;
+    s->cols[j1] ^= c;
+    s->cols[j2] ^= c;
+}
+
+static bool sample_switch(t_sampler* s) {
+    /*
+    swap the 4 cells 1 0 / 0 1 (or 0 1 / 1 0) of 2 rows and 2 columns: the
+    number of 1 of every line is the same. The rows and the columns are next to
+    each other 3 times out of 4, a swap far from the others is rarely kept but
+    needed to reach all the grids. The swap is undone if it makes 3 consecutive
+    0 / 1, return true if it is kept.
+    */
+    int n = s->size;
+    uint64_t full = line_full_mask(n);
+    int i1, i2, j1, j2;
+    uint64_t v;
+
+    if (random() % 4) {
+        i1 = random() % (n - 1);
+        j1 = random() % (n - 1);
+        i2 = i1 + 1;
+        j2 = j1 + 1;
+    } else {
+        i1 = random() % n;
+        j1 = random() % n;
+        i2 = random() % n;
+        j2 = random() % n;
+    }
+    v = (s->rows[i1] >> j1) & 1;
+
+    if (i1 == i2 || j1 == j2 || ((s->rows[i2] >> j2) & 1) != v || ((s->rows[i1] >> j2) & 1) == v || ((s->rows[i2] >> j1) & 1) == v) {
+        return false;
+    }
+    sample_swap(s, i1, i2, j1, j2);
+    if (line_ok(s->rows[i1], full) && line_ok(s->rows[i2], full) && line_ok(s->cols[j1], full) && line_ok(s->cols[j2], full)) {
+        return true;
+    }
+    sample_swap(s, i1, i2, j1, j2);
+    return false;
+}
+
+static bool lines_distinct(const uint64_t* lines, int n) {
+    for (int a = 0; a < n; a++) {
+        for (int b = a + 1; b < n; b++) {
+            if (lines[a] == lines[b]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void shuffle(int* cells, int nb) {
+    // Fisher-Yates
+    int k, tmp;
+    for (int i = nb - 1; i > 0; i--) {
+        k = random() % (i + 1);
+        tmp = cells[i];
+        cells[i] = cells[k];
+        cells[k] = tmp;
+    }
+}
+
+static int* random_cells(int size) {
+    // all the cells (i * size + j) of the grid in a random order, to free
+    int* cells = (int*)malloc(sizeof(int) * size * size);
+    if (cells == NULL) {
+        perror("random_cells");
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c < size * size; c++) {
+        cells[c] = c;
+    }
+    shuffle(cells, size * size);
+    return cells;
+}
+
+static char* solution_save(t_grid* g) {
+    // values of the cells of the complete grid g (i * size + j), to free
+    int size = g->size;
+    char* sol = (char*)malloc(size * size);
+    if (sol == NULL) {
+        perror("solution_save");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            sol[i * size + j] = get_cell(i, j, g);
+        }
+    }
+    return sol;
+}
+
+void generate_full(t_grid* g) {
+    /*
+    fill the empty grid g with a random complete valid grid. The walk starts
+    from the blocks 0 0 / 0 0 and 1 1 / 1 1 put like a chessboard, which is
+    balanced without 3 consecutive 0 / 1, and does random swaps keeping these
+    rules (sample_switch) until SAMPLE_TRIES swaps per cell are tried and all
+    the rows / columns are different.
+    */
+    t_sampler s;
+    int n;
+    long tries = 0;
+    long goal;
+
+    if (g == NULL) {
+        errx(EXIT_FAILURE, "error: generate_full: g is Null\n");
+    }
+    n = s.size = g->size;
+    goal = SAMPLE_TRIES * n * n;
+    memset(s.rows, 0, sizeof(s.rows));
+    memset(s.cols, 0, sizeof(s.cols));
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (((i >> 1) ^ (j >> 1)) & 1) {
+                s.rows[i] |= 1ULL << j;
+                s.cols[j] |= 1ULL << i;
+            }
+        }
+    }
+
+    // lines_distinct is only checked every n swaps
+    do {
+        for (; tries < goal; tries++) {
+            sample_switch(&s);
+        }
+        goal += n;
+    } while (!lines_distinct(s.rows, n) || !lines_distinct(s.cols, n));
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            set_cell(i, j, g, (s.rows[i] >> j) & 1 ? '1' : '0');
+        }
+    }
+}
+
+void generate_clues(t_grid* g, int percent) {
+    // keep percent% of the cells of a random complete grid: the grid has at least a solution
+    int size = g->size;
+    int nb_clues = (size * size * percent) / 100;
+
+    generate_full(g);
+    char* sol = solution_save(g);
+    int* cells = random_cells(size);
+
+    grid_undo(g, 0);
+    for (int k = 0; k < nb_clues; k++) {
+        set_cell(cells[k] / size, cells[k] % size, g, sol[cells[k]]);
+    }
+    free(cells);
+    free(sol);
+}
+
+void generate_unique(t_grid* g) {
+    /*
+    dig holes in a random complete grid: the cells are tried in a random order,
+    a clue is removed if the grid stays unique, i.e. if the grid without it has
+    no solution with the other value in the cell: the result is minimal.
+    A test is a search stopped at the first solution (find_solution_limit).
+    With --dig-budget, it is a search of at most dig_budget branches
+    (budget_search) and a clue whose test goes over it is kept: much faster on
+    the large grids, but the result is only minimal within the budget.
+
+    The same grid is used by all the tests. The cells still to try are set
+    first, the last one to try at the bottom of the trail, so a test only undoes
+    the cell tried and sets the clues kept so far and the other value above
+    them. Everything above the cell tried is undone after the search.
+    */
+    int size = g->size;
+    int nb = size * size;
+    int nb_kept = 0;
+    t_strategy strategy = {BRANCH_AROUND, false, false, 0};
+    t_propagation level = propagation;
+    long budget;
+    bool found;
+    int nb_sol;
+    int c;
+
+    generate_full(g);
+    char* sol = solution_save(g);
+    int* cells = random_cells(size);
+    int* kept = (int*)malloc(sizeof(int) * nb);
+    if (kept == NULL) {
+        perror("generate_unique");
+        exit(EXIT_FAILURE);
+    }
+
+    // the hard tests are the ones without a solution, probing cuts their search a lot
+    propagation = PROPAGATE_PROBE;
+    grid_undo(g, 0);
+    for (int k = nb - 1; k >= 0; k--) {
+        set_cell(cells[k] / size, cells[k] % size, g, sol[cells[k]]);
+    }
+
+    for (int k = 0; k < nb; k++) {
+        // the cells[k + 1 ...] are the nb - k - 1 first cells of the trail
+        grid_undo(g, nb - k - 1);
+        for (int l = 0; l < nb_kept; l++) {
+            set_cell(kept[l] / size, kept[l] % size, g, sol[kept[l]]);
+        }
+        c = cells[k];
+        set_cell(c / size, c % size, g, sol[c] == '0' ? '1' : '0');
+
+        // the grid is not a fixpoint of the euristics: all the lines are checked again
+        g->dirty_rows = line_full_mask(size);
+        g->dirty_cols = line_full_mask(size);
+        if (dig_budget > 0) {
+            found = false;
+            budget = dig_budget;
+            budget_search(g, &strategy, &found, &budget);
+            found = found || budget < 0;
+        } else {
+            nb_sol = 0;
+            find_solution_limit(g, &nb_sol, 1, NULL);
+            found = nb_sol > 0;
+        }
+        if (found) {
+            kept[nb_kept++] = c;
+        }
+    }
+
+    propagation = level;
+    grid_undo(g, 0);
+    for (int l = 0; l < nb_kept; l++) {
+        set_cell(kept[l] / size, kept[l] % size, g, sol[kept[l]]);
+    }
+    if (verbose) {
+        printf("verbose: %d clues kept on %d cells\n", nb_kept, nb);
+    }
+
+    free(kept);
+    free(cells);
+    free(sol);
+}
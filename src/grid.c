@@ -2,8 +2,15 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "bitboard.h"
+#include "corpus.h"
 #include "grid.h"
+#include "parity.h"
+#include "pattern.h"
+#include "pool.h"
+#include "stats.h"
 #include "utils.h"
 
 void grid_allocate(t_grid* g, int size) {
@@ -12,23 +19,37 @@ void grid_allocate(t_grid* g, int size) {
     size is positive, due to the check in the main prog
     */
     g->size = size;
-    g->grid = (char**)malloc(sizeof(char*) * g->size);
-    if (g->grid == NULL) {
-        perror("grid_allocate");
-        exit(EXIT_FAILURE);
-    }
-    for (int i = 0; i < g->size; i++) {
-        g->grid[i] = (char*)malloc(sizeof(char) * g->size);
-        if (g->grid[i] == NULL) {
-            perror("grid_allocate");
-            exit(EXIT_FAILURE);
-        }
-
-        // set the cells with the empty character
-        for (int j = 0; j < g->size; j++) {
-            g->grid[i][j] = '_';
-        }
-    }
+    memset(g->row_filled, 0, sizeof(g->row_filled));
+    memset(g->row_ones, 0, sizeof(g->row_ones));
+    memset(g->col_filled, 0, sizeof(g->col_filled));
+    memset(g->col_ones, 0, sizeof(g->col_ones));
+    g->row_bad = 0;
+    g->col_bad = 0;
+    g->dup_pairs = 0;
+    g->nb_filled = 0;
+    g->conflict = false;
+    g->dirty_rows = 0;
+    g->dirty_cols = 0;
+    memset(g->row_index, 0, sizeof(g->row_index));
+    memset(g->col_index, 0, sizeof(g->col_index));
+
+    g->trail_len = 0;
+    g->changes = 1;
+
+    // every cell is empty without filled cells around
+    memset(g->around, 0, sizeof(g->around));
+    memset(g->around_rows, 0, sizeof(g->around_rows));
+    for (int i = 0; i < size; i++) {
+        g->around_row[i] = 0;
+    }
+    g->around_rows[0] = line_full_mask(size);
+    g->around_dirty = 0;
+    memset(g->row_weight, 0, sizeof(g->row_weight));
+    memset(g->col_weight, 0, sizeof(g->col_weight));
+    g->line_kind = -1;
+
+    // the cells, the trail, the probe keys and the domains (pool.c), the classes when they are used
+    pool_get(g, size);
 }
 
 void grid_free(t_grid* g) {
@@ -36,188 +57,386 @@ void grid_free(t_grid* g) {
         warnx("warning: grid_free: the grid is already null");
         return;
     }
-    for (int i = 0; i < g->size; i++) {
-        free(g->grid[i]);
+    if (g->block == NULL) {
+        warnx("warning: grid_free: the grid is not allocated");
+        return;
+    }
+    // the buffers are kept in the pool for the next grid_allocate
+    pool_put(g);
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static char* row_render(char* p, uint64_t filled, uint64_t ones, int n, bool sep) {
+    /*
+    write the row "c c c ... " (or "ccc..." without sep) at p from its masks, 4 cells
+    at once: their 4 bits are spread on 16 bits lanes (a char and its space) or
+    on bytes, each lane is '_' (0x5F) minus 0x2F if the cell is filled plus its value
+    */
+    uint64_t f, o, w;
+    uint32_t c;
+
+    for (int k = 0; k < n; k += 4) {
+        if (sep) {
+            f = (((filled >> k) & 0xF) * 0x0000200040008001ULL) & 0x0001000100010001ULL;
+            o = (((ones >> k) & 0xF) * 0x0000200040008001ULL) & 0x0001000100010001ULL;
+            w = 0x205F205F205F205FULL - f * 0x2F + o;
+            memcpy(p, &w, sizeof(w));
+            p += 8;
+        } else {
+            f = (((filled >> k) & 0xF) * 0x204081ULL) & 0x01010101ULL;
+            o = (((ones >> k) & 0xF) * 0x204081ULL) & 0x01010101ULL;
+            c = (uint32_t)(0x5F5F5F5FULL - f * 0x2F + o);
+            memcpy(p, &c, sizeof(c));
+            p += 4;
+        }
+    }
+    return p;
+}
+#else
+static char* row_render(char* p, uint64_t filled, uint64_t ones, int n, bool sep) {
+    for (int j = 0; j < n; j++) {
+        *p++ = (filled >> j) & 1 ? '0' + ((ones >> j) & 1) : '_';
+        if (sep) {
+            *p++ = ' ';
+        }
     }
-    free(g->grid);
+    return p;
 }
+#endif
 
 void grid_print(t_grid* g, FILE* fd) {
-    // use stdout if no fd are used
+    /*
+    use stdout if no fd are used
+    the grid is rendered from its masks in a buffer, written at once
+    */
+    char buf[MAX_GRID_SIZE * (2 * MAX_GRID_SIZE + 1) + 1];
+    char* p = buf;
+
     if (fd == NULL) {
         fd = stdout;
     }
     for (int i = 0; i < g->size; i++) {
-        for (int j = 0; j < g->size; j++) {
-            fprintf(fd, "%c ", g->grid[i][j]);
-        }
-        fprintf(fd, "\n");
+        p = row_render(p, g->row_filled[i], g->row_ones[i], g->size, true);
+        *p++ = '\n';
+    }
+    *p++ = '\n';
+    fwrite(buf, 1, p - buf, fd);
+}
+
+void grid_print_line(t_grid* g, FILE* fd) {
+    // compact output: the cells of the grid row by row on one line, without separator
+    char buf[MAX_GRID_SIZE * MAX_GRID_SIZE + 1];
+    char* p = buf;
+
+    for (int i = 0; i < g->size; i++) {
+        p = row_render(p, g->row_filled[i], g->row_ones[i], g->size, false);
     }
-    fprintf(fd, "\n");
+    *p++ = '\n';
+    fwrite(buf, 1, p - buf, fd);
 }
 
 bool check_char(const char c) {
     return c == '0' || c == '1' || c == '_';
 }
 
-bool check_sep(const char c) {
+static bool line_breaks_rules(uint64_t filled, uint64_t ones, int n, bool is_row, int k) {
     /*
-    return true if c is a separator for grid file
+    check the rules of the takuzu which only depend on one line:
+    no 3 consecutive 0 / 1 and no more than n/2 0 (resp. 1)
     */
-    return c == ' ' || c == '\t';
+    const char* kind = is_row ? "line" : "column";
+    uint64_t zeros = line_zeros(filled, ones);
+
+    if (line_triples(ones) || line_triples(zeros)) {
+        if (verbose) {
+            printf("verbose: check_consecutive: 3 consecutive '%c' in %s %u\n", line_triples(ones) ? '1' : '0', kind, k);
+        }
+        return true;
+    }
+    if (line_count(ones) > n / 2 || line_count(zeros) > n / 2) {
+        if (verbose) {
+            printf("verbose: check_count: disproportion of value at %s %u\n", kind, k);
+        }
+        return true;
+    }
+    return false;
 }
 
-int number_of_column(char* s) {
-    /*
-    count the size of the string (stop at # and \n) 
-    */
+static unsigned int line_index_hash(uint64_t key) {
+    // Fibonacci hashing, LINE_INDEX_SIZE is a power of 2
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (LINE_INDEX_SIZE - 1);
+}
+
+int line_index_count(const t_line_slot* index, uint64_t key) {
+    // number of full lines of the index equal to key
+    unsigned int h = line_index_hash(key);
+    while (index[h].count != 0) {
+        if (index[h].key == key) {
+            return index[h].count;
+        }
+        h = (h + 1) & (LINE_INDEX_SIZE - 1);
+    }
+    return 0;
+}
 
-    int i = 0;
-    int cpt = 0;
-    while (s[i] != '\0' && s[i] != '#' && s[i] != '\n') {
+static int line_index_add(t_line_slot* index, uint64_t key) {
+    // add a full line to the index, return the number of similar lines already in it
+    unsigned int h = line_index_hash(key);
+    while (index[h].count != 0 && index[h].key != key) {
+        h = (h + 1) & (LINE_INDEX_SIZE - 1);
+    }
+    index[h].key = key;
+    return index[h].count++;
+}
 
-        if (check_char(s[i])) {
-            cpt++;
+static int line_index_remove(t_line_slot* index, uint64_t key) {
+    // remove a full line of the index, return the number of similar lines left in it
+    unsigned int h = line_index_hash(key);
+    while (index[h].key != key || index[h].count == 0) {
+        h = (h + 1) & (LINE_INDEX_SIZE - 1);
+    }
+    if (--index[h].count != 0) {
+        return index[h].count;
+    }
+
+    // the slot is free, shift back the next slots of the cluster (linear probing)
+    unsigned int free_slot = h;
+    unsigned int home;
+    for (h = (h + 1) & (LINE_INDEX_SIZE - 1); index[h].count != 0; h = (h + 1) & (LINE_INDEX_SIZE - 1)) {
+        home = line_index_hash(index[h].key);
+        // move the slot h if its home is not between the free slot and h (cyclically)
+        if (((h - home) & (LINE_INDEX_SIZE - 1)) >= ((h - free_slot) & (LINE_INDEX_SIZE - 1))) {
+            index[free_slot] = index[h];
+            index[h].count = 0;
+            free_slot = h;
         }
-        i++;
     }
-    return cpt;
+    return 0;
 }
 
-bool is_comment_line(char* s) {
-    int i = 0;
-    while (s[i] != '\0' && s[i] != '\n') {
-        if (s[i] == '#') {
-            return true;
-        } else if (!check_sep(s[i])) {
-            return false;
+uint64_t grid_around_best(t_grid* g, int i, int* score) {
+    // empty cells of the row i with the best score, *score is -1 if the row is full
+    uint64_t best = line_full_mask(g->size) & ~g->row_filled[i];
+    uint64_t t;
+
+    *score = best ? 0 : -1;
+    for (int b = 3; b >= 0 && best; b--) {
+        t = best & g->around[i][b];
+        if (t) {
+            best = t;
+            *score |= 1 << b;
         }
-        i++;
     }
-    return true;
+    return best;
 }
 
-void file_parser(t_grid* g, char* fname) {
-    /*
-    Parse the file fname and fill the g grid, 
-    Possibility to use comment with '#'
-    separator between value of the grid 
-    can be ' ' (blank) or '\t' (tabulation)
-    don't accept empty line without comment 
-    */
-    // Opening the file first
-    FILE* fd = fopen(fname, "r");
-    // checking error
-    if (!fd) {
-        perror("error when opening the file");
-        exit(EXIT_FAILURE);
-    }
-
-    int i = 0;
-    int j = 0;
-    int iline = 0;
-    int icol = 0;
-    int endf;
-
-    char toprint;
-
-    char* buf = NULL;
-    size_t size_buf = 0;
-    int size_grid;
-    // check the first line
-    endf = getline(&buf, &size_buf, fd);
-    if (endf == -1) {
-        free(buf);
-        fclose(fd);
-        errx(EXIT_FAILURE, "error: %s: empty file", fname);
+void grid_around_refresh(t_grid* g) {
+    // put the rows changed since the last call in the bucket of their best score
+    int i, s;
+    for (; g->around_dirty; g->around_dirty &= g->around_dirty - 1) {
+        i = __builtin_ctzll(g->around_dirty);
+        grid_around_best(g, i, &s);
+        if (s != g->around_row[i]) {
+            if (g->around_row[i] >= 0) {
+                g->around_rows[g->around_row[i]] &= ~(1ULL << i);
+            }
+            if (s >= 0) {
+                g->around_rows[s] |= 1ULL << i;
+            }
+            g->around_row[i] = s;
+        }
     }
+}
+
+static void around_update(t_grid* g, int i, int j, bool filled) {
     /*
-    skip the first comment lines
+    the cell (i, j) was filled (or emptied): add 1 (or remove 1) to the scores
+    of the cells around, on the bit planes of the rows i - 1 to i + 1, the
+    buckets of these rows are updated by grid_around_refresh
     */
-    while (endf != -1 && is_comment_line(buf)) {
-        endf = getline(&buf, &size_buf, fd);
-        iline++;
+    int n = g->size;
+    uint64_t bit = 1ULL << j;
+    uint64_t mask = (bit | (bit << 1) | (bit >> 1)) & line_full_mask(n);
+    uint64_t flip = filled ? 0 : ~0ULL; // a borrow is a carry on the complement
+    uint64_t carry, t;
+    int first = i > 0 ? i - 1 : 0;
+    int last = i < n - 1 ? i + 1 : n - 1;
+
+    for (int x = first; x <= last; x++) {
+        carry = x == i ? mask & ~bit : mask;
+        for (int b = 0; b < 4; b++) {
+            t = (g->around[x][b] ^ flip) & carry;
+            g->around[x][b] ^= carry;
+            carry = t;
+        }
     }
+    g->around_dirty |= line_full_mask(last - first + 1) << first;
+}
 
+static void cell_write(int i, int j, t_grid* g, char v) {
     /*
-    treat the case if there are only comment in the file
+    write v in the cell i,j and update the row / column masks
+    only the row i and the column j are checked again, the result is
+    kept in row_bad, col_bad and dup_pairs which are read by is_consistent,
+    the full lines are found in row_index / col_index in constant time
     */
-    if (endf == -1) {
-        free(buf);
-        fclose(fd);
-        errx(EXIT_FAILURE, "error: %s: no grid in this file", fname);
-    }
+    uint64_t full = line_full_mask(g->size);
+    uint64_t rbit = 1ULL << j;
+    uint64_t cbit = 1ULL << i;
+    int similar;
+    bool flip;
 
-    //getting the grid size
-    size_grid = number_of_column(buf);
-    if (!control_size_grid(size_grid)) {
-        free(buf);
-        fclose(fd);
-        errx(EXIT_FAILURE, "error: %s: line %d is malformed", fname, iline + 1);
+    g->changes++;
+    // the lines are not full anymore (or change), remove their similar pairs
+    if (g->row_filled[i] == full) {
+        g->dup_pairs -= line_index_remove(g->row_index, g->row_ones[i]);
     }
+    if (g->col_filled[j] == full) {
+        g->dup_pairs -= line_index_remove(g->col_index, g->col_ones[j]);
+    }
+    if (g->grid[i][j] != '_') {
+        g->nb_filled--;
+    }
+    flip = (g->grid[i][j] == '_') != (v == '_');
 
-    // Now we have the supposed size, so we can allocate the grid
-    grid_allocate(g, size_grid);
+    g->grid[i][j] = v;
+    g->row_filled[i] &= ~rbit;
+    g->row_ones[i] &= ~rbit;
+    g->col_filled[j] &= ~cbit;
+    g->col_ones[j] &= ~cbit;
 
-    iline++;
+    if (v != '_') {
+        g->row_filled[i] |= rbit;
+        g->col_filled[j] |= cbit;
+        g->nb_filled++;
+        g->dirty_rows |= cbit;
+        g->dirty_cols |= rbit;
+    }
+    if (v == '1') {
+        g->row_ones[i] |= rbit;
+        g->col_ones[j] |= cbit;
+    }
+    if (flip) {
+        around_update(g, i, j, v != '_');
+    }
+    g->line_dirty_rows |= cbit;
+    g->line_dirty_cols |= rbit;
 
-    // parsing each line
-    while (endf != -1) {
-        icol = 0;
-        j = 0;
-        // treat the line if it's not a comment line
-        if (!is_comment_line(buf)) {
+    g->row_bad &= ~cbit;
+    if (line_breaks_rules(g->row_filled[i], g->row_ones[i], g->size, true, i)) {
+        g->row_bad |= cbit;
+    }
+    g->col_bad &= ~rbit;
+    if (line_breaks_rules(g->col_filled[j], g->col_ones[j], g->size, false, j)) {
+        g->col_bad |= rbit;
+    }
 
-            // check the number of line to parse
-            if (i >= size_grid) {
-                free(buf);
-                fclose(fd);
-                grid_free(g);
-                errx(EXIT_FAILURE, "error: %s: too many lines to parse, required %d according to the column", fname, size_grid);
-            }
+    // a full line is not a valid pattern for the other lines anymore (pattern.c)
+    if (v != '_' && g->row_filled[i] == full) {
+        g->dirty_rows = full;
+    }
+    if (v != '_' && g->col_filled[j] == full) {
+        g->dirty_cols = full;
+    }
 
-            // check each char until the end of the line
-            while (buf[icol] != '\n' && buf[icol] != '\0' && buf[icol] != '#') {
-
-                // if a valid char, add it to the grid
-                if (check_char(buf[icol])) {
-
-                    // case where we have too much / less valid char on the line
-                    if (j >= size_grid) {
-                        free(buf);
-                        fclose(fd);
-                        grid_free(g);
-                        errx(EXIT_FAILURE, "error: %s: line %d is malformed", fname, iline + 1);
-                    }
-
-                    g->grid[i][j] = buf[icol];
-                    j++;
-                    // if not  a separator char : error
-                } else if (!check_sep(buf[icol])) {
-                    toprint = buf[icol]; // because we free
-                    free(buf);
-                    fclose(fd);
-                    grid_free(g);
-                    errx(EXIT_FAILURE, "error: %s: wrong character '%c' at line %d", fname, toprint, iline + 1);
-                }
+    if (g->row_filled[i] == full && (similar = line_index_add(g->row_index, g->row_ones[i])) != 0) {
+        g->dup_pairs += similar;
+        if (verbose) {
+            printf("verbose: check_line: line %u similar to %d other line(s)\n", i, similar);
+        }
+    }
+    if (g->col_filled[j] == full && (similar = line_index_add(g->col_index, g->col_ones[j])) != 0) {
+        g->dup_pairs += similar;
+        if (verbose) {
+            printf("verbose: check_column: column %u similar to %d other column(s)\n", j, similar);
+        }
+    }
+}
 
-                icol++;
-            }
-            i++;
+bool file_parser(t_grid* g, char* fname, long k) {
+    /*
+    Parse the file fname and fill the g grid with its grid k, from 0 (see corpus.c),
+    Possibility to use comment with '#'
+    separator between value of the grid
+    can be ' ' (blank) or '\t' (tabulation)
+    Return true if other grids follow this one in the file.
+    */
+    t_corpus c;
+    bool more;
+    corpus_open(&c, fname);
+    if (!corpus_seek(&c, k) || !corpus_next(&c, g)) {
+        corpus_close(&c);
+        if (k > 0) {
+            errx(EXIT_FAILURE, "error: %s: no grid %ld in this file", fname, k + 1);
         }
-        iline++;
-        endf = getline(&buf, &size_buf, fd);
+        errx(EXIT_FAILURE, "error: %s: no grid in this file", fname);
     }
+    more = !corpus_end(&c);
+    corpus_close(&c);
+    return more;
+}
 
-    if (i < size_grid) {
-        grid_free(g);
-        free(buf);
-        fclose(fd);
-        errx(EXIT_FAILURE, "error: %s: grid has %d missing line(s)!", fname, size_grid - i);
+void load_row(int i, t_grid* g, uint64_t filled, uint64_t ones) {
+    /*
+    write the filled cells of the empty row i of a grid being read, not in the
+    trail: it is never undone. The checks of the lines are left to load_done,
+    once for the whole grid instead of once per cell as in cell_write.
+    */
+    uint64_t cbit = 1ULL << i;
+    int j;
+
+    g->changes++;
+    g->row_filled[i] = filled;
+    g->row_ones[i] = ones;
+    g->nb_filled += line_count(filled);
+    if (filled) {
+        g->dirty_rows |= cbit;
+        g->dirty_cols |= filled;
+        g->line_dirty_rows |= cbit;
+        g->line_dirty_cols |= filled;
+    }
+    for (; filled; filled &= filled - 1) {
+        j = __builtin_ctzll(filled);
+        g->grid[i][j] = (ones >> j) & 1 ? '1' : '0';
+        g->col_filled[j] |= cbit;
+        if ((ones >> j) & 1) {
+            g->col_ones[j] |= cbit;
+        }
+        around_update(g, i, j, true);
     }
+}
+
+void load_done(t_grid* g) {
+    // the checks of cell_write on all the lines of a grid written by load_row
+    uint64_t full = line_full_mask(g->size);
+    int similar;
 
-    free(buf);
-    fclose(fd);
+    for (int k = 0; k < g->size; k++) {
+        if (line_breaks_rules(g->row_filled[k], g->row_ones[k], g->size, true, k)) {
+            g->row_bad |= 1ULL << k;
+        }
+        if (line_breaks_rules(g->col_filled[k], g->col_ones[k], g->size, false, k)) {
+            g->col_bad |= 1ULL << k;
+        }
+        if (g->row_filled[k] == full) {
+            g->dirty_rows = full;
+            if ((similar = line_index_add(g->row_index, g->row_ones[k])) != 0) {
+                g->dup_pairs += similar;
+                if (verbose) {
+                    printf("verbose: check_line: line %u similar to %d other line(s)\n", k, similar);
+                }
+            }
+        }
+        if (g->col_filled[k] == full) {
+            g->dirty_cols = full;
+            if ((similar = line_index_add(g->col_index, g->col_ones[k])) != 0) {
+                g->dup_pairs += similar;
+                if (verbose) {
+                    printf("verbose: check_column: column %u similar to %d other column(s)\n", k, similar);
+                }
+            }
+        }
+    }
 }
 
 void grid_copy(t_grid* gs, t_grid* gd) {
@@ -229,9 +448,40 @@ void grid_copy(t_grid* gs, t_grid* gd) {
 
     // deep copy
     for (int i = 0; i < gd->size; i++) {
-        for (int j = 0; j < gd->size; j++) {
-            gd->grid[i][j] = gs->grid[i][j];
-        }
+        memcpy(gd->grid[i], gs->grid[i], gd->size);
+    }
+    memcpy(gd->row_filled, gs->row_filled, sizeof(gs->row_filled));
+    memcpy(gd->row_ones, gs->row_ones, sizeof(gs->row_ones));
+    memcpy(gd->col_filled, gs->col_filled, sizeof(gs->col_filled));
+    memcpy(gd->col_ones, gs->col_ones, sizeof(gs->col_ones));
+    gd->row_bad = gs->row_bad;
+    gd->col_bad = gs->col_bad;
+    gd->dup_pairs = gs->dup_pairs;
+    gd->nb_filled = gs->nb_filled;
+    gd->conflict = gs->conflict;
+    gd->dirty_rows = gs->dirty_rows;
+    gd->dirty_cols = gs->dirty_cols;
+    memcpy(gd->row_index, gs->row_index, sizeof(gs->row_index));
+    memcpy(gd->col_index, gs->col_index, sizeof(gs->col_index));
+    memcpy(gd->around, gs->around, sizeof(gs->around));
+    memcpy(gd->around_row, gs->around_row, sizeof(gs->around_row));
+    gd->around_dirty = gs->around_dirty;
+    memcpy(gd->around_rows, gs->around_rows, sizeof(gs->around_rows));
+    gd->line_kind = gs->line_kind;
+    memcpy(gd->line_level, gs->line_level, sizeof(gs->line_level));
+    memcpy(gd->level_rows, gs->level_rows, sizeof(gs->level_rows));
+    memcpy(gd->level_cols, gs->level_cols, sizeof(gs->level_cols));
+    gd->levels = gs->levels;
+    gd->line_dirty_rows = gs->line_dirty_rows;
+    gd->line_dirty_cols = gs->line_dirty_cols;
+    memcpy(gd->row_weight, gs->row_weight, sizeof(gs->row_weight));
+    memcpy(gd->col_weight, gs->col_weight, sizeof(gs->col_weight));
+    memcpy(gd->probe_key, gs->probe_key, sizeof(uint64_t) * gs->size * gs->size);
+    gd->changes = gs->changes;
+    domains_copy(gs, gd);
+    if (gs->parity != NULL) {
+        pool_parity(gd);
+        parity_copy(gs, gd);
     }
 }
 
@@ -252,6 +502,21 @@ void check_bound_error(int i, int j, t_grid* g) {
     }
 }
 
+static void trail_push(t_grid* g, int cell) {
+    if (g->trail_len == g->trail_cap) {
+        // only when cells are emptied by set_cell, the search uses grid_undo
+        g->trail_cap *= 2;
+        g->trail = (int*)realloc(g->trail, sizeof(int) * g->trail_cap);
+        if (g->trail == NULL) {
+            perror("trail_push");
+            exit(EXIT_FAILURE);
+        }
+        g->block->trail = g->trail;
+        g->block->trail_cap = g->trail_cap;
+    }
+    g->trail[g->trail_len++] = cell;
+}
+
 void set_cell(int i, int j, t_grid* g, char v) {
     // set the char v in the cell i,j of the grid g
     check_bound_error(i, j, g);
@@ -260,7 +525,10 @@ void set_cell(int i, int j, t_grid* g, char v) {
         errx(EXIT_FAILURE, "error: set_cell: invalid inserted char %c", v);
     }
 
-    g->grid[i][j] = v;
+    if (g->grid[i][j] == '_' && v != '_') {
+        trail_push(g, i * g->size + j);
+    }
+    cell_write(i, j, g, v);
     if (verbose) {
         printf("verbose: set_cell: cell (%u, %u) set to %c\n", i, j, v);
     }
@@ -272,227 +540,33 @@ char get_cell(int i, int j, t_grid* g) {
     return g->grid[i][j];
 }
 
-static bool same_line(int l1, int l2, t_grid* g) {
-    // check if line l1 is equal to line l2
-    check_bound_error(l1, l2, g);
-    for (int j = 0; j < g->size; j++) {
-        if (g->grid[l1][j] == '_' || g->grid[l2][j] == '_') {
-            return false;
-        }
-        if (g->grid[l1][j] != g->grid[l2][j]) {
-            return false;
-        }
-    }
-    return true;
-}
-
-static bool check_line(t_grid* g) {
-    // compare all the line to check if two are similar
-    for (int i = 0; i < g->size; i++) {
-        for (int j = i + 1; j < g->size; j++) {
-            if (same_line(i, j, g)) {
-                if (verbose) {
-                    printf("verbose: check_line: similar line %u %u\n", i, j);
-                }
-                return false;
-            }
-        }
-    }
-    return true;
-}
-
-static bool same_column(int c1, int c2, t_grid* g) {
-    // check if column c1 is equal to column c2
-    check_bound_error(c1, c2, g);
-    for (int i = 0; i < g->size; i++) {
-        if (g->grid[i][c1] == '_' || g->grid[i][c2] == '_') {
-            return false;
-        }
-        if (g->grid[i][c1] != g->grid[i][c2]) {
-            return false;
-        }
-    }
-    return true;
+int grid_trail_mark(t_grid* g) {
+    // return the current position of the trail, to give to grid_undo later
+    return g->trail_len;
 }
 
-static bool check_column(t_grid* g) {
-    // compare all the column to check if two are similar
-    for (int i = 0; i < g->size; i++) {
-        for (int j = i + 1; j < g->size; j++) {
-            if (same_column(i, j, g)) {
-                if (verbose) {
-                    printf("verbose: check_column: similar column %u %u\n", i, j);
-                }
-                return false;
-            }
+void grid_undo(t_grid* g, int mark) {
+    // empty again every cell assigned since the mark, the last assigned first
+    int cell;
+    while (g->trail_len > mark) {
+        cell = g->trail[--g->trail_len];
+        if (g->grid[cell / g->size][cell % g->size] != '_') {
+            cell_write(cell / g->size, cell % g->size, g, '_');
         }
     }
-    return true;
-}
-
-static bool check_count(t_grid* g) {
-    /*
-    This function will check if there is the same amount of 0 and 1 
-    for each line / col
-    work if the grid is filled
-    */
-
-    /*
-    optimisation idea:
-        1 list containing the count of 0 for each column
-        1 list containing the count of 0 for each line
-        after bowsing the grid, check the counter for each list. 
-    */
-    unsigned int n = g->size;
-
-    // line check
-    unsigned int count0;
-    unsigned int count1;
-    for (unsigned int i = 0; i < n; i++) {
-        count0 = 0;
-        count1 = 0;
-        for (unsigned int j = 0; j < n; j++) {
-            if (g->grid[i][j] == '0') {
-                count0++;
-            } else if (g->grid[i][j] == '1') {
-                count1++;
-            }
-        }
-
-        if ((count0 > n / 2) || (count1 > n / 2)) {
-            if (verbose) {
-                printf("verbose: check_count: disproportion value at line %u\n", i);
-            }
-            return false;
-        }
-    }
-
-    // column check
-    for (unsigned int i = 0; i < n; i++) {
-        count0 = 0;
-        count1 = 0;
-        for (unsigned int j = 0; j < n; j++) {
-            if (g->grid[j][i] == '0') {
-                count0++;
-            } else if (g->grid[j][i] == '1') {
-                count1++;
-            }
-        }
-
-        if ((count0 > n / 2) || (count1 > n / 2)) {
-            if (verbose) {
-                printf("verbose: check_count: disproportion of value at column %u\n", i);
-            }
-            return false;
-        }
-    }
-
-    return true;
-}
-
-static bool check_consecutive_4line(t_grid* g) {
-    // Check if there are three consecutive 0 or 1 on the lines of the grid
-    unsigned int n = g->size;
-
-    for (unsigned int i = 0; i < n; i++) {
-        for (unsigned int j = 0; j < n - 2; j++) {
-            // check each [..., x, y, z, ...] if (x = y = z != '_') then it's false
-            if (g->grid[i][j] != '_' && g->grid[i][j] == g->grid[i][j + 1] && g->grid[i][j] == g->grid[i][j + 2]) {
-                if (verbose) {
-                    printf("verbose: check_consecutive: 3 consecutive '%c' in line %u\n", g->grid[i][j], i);
-                }
-                return false;
-            }
-        }
-    }
-    return true;
-}
-
-static bool check_consecutive_4col(t_grid* g) {
-    // Check if there are three consecutive 0 or 1 on the columns of the grid
-    unsigned int n = g->size;
-
-    for (unsigned int j = 0; j < n; j++) {
-        for (unsigned int i = 0; i < n - 2; i++) {
-            // check each [..., x, y, z, ...] if (x = y = z != '_') then it's false
-            if (g->grid[i][j] != '_' && g->grid[i][j] == g->grid[i + 1][j] && g->grid[i][j] == g->grid[i + 2][j]) {
-                if (verbose) {
-                    printf("verbose: check_consecutive: 3 consecutive '%c' in column %u\n", g->grid[i][j], j);
-                }
-                return false;
-            }
-        }
-    }
-    return true;
-}
-
-static bool check_consecutive(t_grid* g) {
-    // check if there are consecutive 0 / 1 on the grid
-    return check_consecutive_4line(g) && check_consecutive_4col(g);
-}
-
-static bool is_full(t_grid* g) {
-    // check if the grid is full
-    unsigned int n = g->size;
-    for (unsigned int i = 0; i < n; i++) {
-        for (unsigned int j = 0; j < n; j++) {
-            if (g->grid[i][j] == '_') {
-                if (verbose) {
-                    printf("verbose: if_full: '_' char at line %u, column %u\n", i, j);
-                }
-                return false;
-            }
-        }
-    }
-    return true;
+    domains_undo(g, mark);
+    parity_undo(g, mark);
+    g->conflict = false;
 }
 
 bool is_consistent(t_grid* g) {
-    return check_consecutive(g) && check_line(g) && check_column(g) && check_count(g);
+    // the state is maintained by set_cell, see cell_write
+    stats.checks++;
+    return grid_consistent(g);
 }
 
 bool is_valid(t_grid* g) {
-    return is_full(g) && is_consistent(g);
-}
-
-void fill_grid(t_grid* g) {
-    /*
-    this function will fill the empty grid g with a N% of 0-1, the grid has
-    to be consistent
-    */
-    if (g == NULL) {
-        errx(EXIT_FAILURE, "error: fill_grid: g is Null\n");
-    }
-
-    unsigned int size = g->size;
-    unsigned count = 0;
-    unsigned int n_cell_to_fill = (size * size * N) / 100; // just a cross product
-    unsigned int i = random() % size;
-    unsigned int j = random() % size;
-    unsigned int c;
-
-    while (count < n_cell_to_fill) {
-
-        i = random() % size;
-        j = random() % size;
-        c = random() % 2;
-
-        if (g->grid[i][j] == '_') {
-            count++;
-        }
-
-        if (c) {
-            set_cell(i, j, g, '1');
-        } else {
-            set_cell(i, j, g, '0');
-        }
-
-        if (!is_consistent(g)) {
-            set_cell(i, j, g, '_');
-            count--;
-        }
-        //grid_print(g, NULL);
-    }
+    return g->nb_filled == g->size * g->size && is_consistent(g);
 }
 
 void set_grid_empty(t_grid* g) {
@@ -0,0 +1,278 @@
+#include <err.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "backtracking.h"
+#include "bitboard.h"
+#include "euristic.h"
+#include "generator.h"
+#include "grid.h"
+#include "utils.h"
+
+/*
+Microbenchmark of the primitives of the solver, linked with the objects of
+takuzu. Each primitive is timed alone on fixed grids: a complete grid of
+each size generated with a fixed seed, with a fixed part of its cells kept
+(the same cells in all the runs). A measure is a loop calibrated to last
+about the time given with -t, the best of MEASURES measures is kept.
+*/
+
+#define MEASURES 5
+#define SEED     1
+
+bool verbose = 0;
+
+static const int sizes[] = {4, 8, 16, 32, 64};
+static const int fills[] = {0, 25, 50, 75, 100}; // percent of the cells kept
+
+static volatile long sink; // results of the calls, so they are not optimised away
+
+typedef struct {
+    const char* name;
+    bool need_empty;  // only on grids with an empty cell
+    bool need_filled; // only on grids with a filled cell
+    void (*run)(t_grid*, long);
+} t_primitive;
+
+static void run_consistent(t_grid* g, long nb) {
+    long cpt = 0;
+    for (long k = 0; k < nb; k++) {
+        cpt += is_consistent(g);
+    }
+    sink = cpt;
+}
+
+static void run_valid(t_grid* g, long nb) {
+    long cpt = 0;
+    for (long k = 0; k < nb; k++) {
+        cpt += is_valid(g);
+    }
+    sink = cpt;
+}
+
+static void run_set_undo(t_grid* g, long nb) {
+    /*
+    set_cell and its grid_undo on the cell at the top of the trail: the checks
+    of its row and its column, and the index of the full lines when they are
+    completed (the pairwise comparison of check_line before)
+    */
+    int mark = grid_trail_mark(g) - 1;
+    int c = g->trail[mark];
+    int i = c / g->size;
+    int j = c % g->size;
+    char v = g->grid[i][j];
+
+    grid_undo(g, mark);
+    for (long k = 0; k < nb; k++) {
+        set_cell(i, j, g, v);
+        grid_undo(g, mark);
+    }
+    set_cell(i, j, g, v);
+}
+
+static void run_euristics(t_grid* g, long nb) {
+    // the fixpoint from all the lines, then grid_undo of its cells
+    uint64_t full = line_full_mask(g->size);
+    int mark = grid_trail_mark(g);
+    long cpt = 0;
+    for (long k = 0; k < nb; k++) {
+        g->dirty_rows = full;
+        g->dirty_cols = full;
+        cpt += apply_euristics(g);
+        grid_undo(g, mark);
+    }
+    sink = cpt;
+}
+
+static void run_choice(t_grid* g, long nb) {
+    // the scores of all the rows are computed again at each call
+    uint64_t full = line_full_mask(g->size);
+    long cpt = 0;
+    for (long k = 0; k < nb; k++) {
+        g->around_dirty = full;
+        cpt += grid_choice(g).row;
+    }
+    sink = cpt;
+}
+
+static void run_copy(t_grid* g, long nb) {
+    t_grid copy;
+    for (long k = 0; k < nb; k++) {
+        grid_copy(g, &copy);
+        grid_free(&copy);
+    }
+}
+
+static void run_allocate(t_grid* g, long nb) {
+    t_grid a;
+    for (long k = 0; k < nb; k++) {
+        grid_allocate(&a, g->size);
+        grid_free(&a);
+    }
+}
+
+static const t_primitive primitives[] = {
+    {  "is_consistent", false, false, run_consistent},
+    {       "is_valid", false, false,      run_valid},
+    {  "set_cell+undo", false,  true,   run_set_undo},
+    {"apply_euristics", false, false,  run_euristics},
+    {    "grid_choice",  true, false,     run_choice},
+    {      "grid_copy", false, false,       run_copy},
+    {  "grid_allocate", false, false,   run_allocate},
+};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void grid_build(t_grid* g, int size, int fill) {
+    // the complete grid of the seed with fill % of its cells, set in a fixed random order
+    t_grid full;
+    int nb = size * size;
+    int* cells = (int*)malloc(sizeof(int) * nb);
+    int r, tmp;
+
+    if (cells == NULL) {
+        perror("grid_build");
+        exit(EXIT_FAILURE);
+    }
+    srand(SEED);
+    grid_allocate(&full, size);
+    generate_full(&full);
+
+    for (int c = 0; c < nb; c++) {
+        cells[c] = c;
+    }
+    for (int c = nb - 1; c > 0; c--) {
+        r = rand() % (c + 1);
+        tmp = cells[c];
+        cells[c] = cells[r];
+        cells[r] = tmp;
+    }
+
+    grid_allocate(g, size);
+    for (int c = 0; c < nb * fill / 100; c++) {
+        set_cell(cells[c] / size, cells[c] % size, g, full.grid[cells[c] / size][cells[c] % size]);
+    }
+    grid_free(&full);
+    free(cells);
+}
+
+static double measure(const t_primitive* p, t_grid* g, double target) {
+    // ns per call of the best measure, the number of calls is doubled until a loop lasts target seconds
+    long nb = 1;
+    double t, best;
+
+    for (;;) {
+        t = now();
+        p->run(g, nb);
+        t = now() - t;
+        if (t >= target || nb >= 1L << 40) {
+            break;
+        }
+        nb = t > target / 64 ? (long)(nb * target / t) + 1 : nb * 2;
+    }
+
+    best = t;
+    for (int m = 1; m < MEASURES; m++) {
+        t = now();
+        p->run(g, nb);
+        t = now() - t;
+        if (t < best) {
+            best = t;
+        }
+    }
+    return best * 1e9 / nb;
+}
+
+static void usage(char* prog) {
+    printf("Usage:\t%s [-t MS] [-s SIZE] [PRIMITIVE...]\n", prog);
+    printf("Time the primitives of the solver on fixed grids of each size and fill ratio\n");
+    printf("-t MS duration of a measure in milliseconds (default: 20), the best of %d measures is kept\n", MEASURES);
+    printf("-s SIZE only the grids of this size\n");
+    printf("-h display this help and exit\n");
+    printf("PRIMITIVE...");
+    for (size_t k = 0; k < sizeof(primitives) / sizeof(primitives[0]); k++) {
+        printf(" %s", primitives[k].name);
+    }
+    printf(" (default: all)\n");
+}
+
+static bool selected(const char* name, char** names, int nb_names) {
+    for (int k = 0; k < nb_names; k++) {
+        if (strcmp(name, names[k]) == 0) {
+            return true;
+        }
+    }
+    return nb_names == 0;
+}
+
+int main(int argc, char* argv[]) {
+    double target = 0.02;
+    int only_size = 0;
+    int opt;
+    t_grid g;
+    double ns;
+
+    while ((opt = getopt(argc, argv, "ht:s:")) != -1) {
+        switch (opt) {
+            case 't':
+                target = atof(optarg) / 1000;
+                if (target <= 0) {
+                    errx(EXIT_FAILURE, "error: -t MS: invalid duration '%s'", optarg);
+                }
+                break;
+            case 's':
+                only_size = atoi(optarg);
+                if (!control_size_grid(only_size)) {
+                    errx(EXIT_FAILURE, "error: -s SIZE: invalid size grid '%s'", optarg);
+                }
+                break;
+            case 'h':
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    for (int k = optind; k < argc; k++) {
+        bool known = false;
+        for (size_t p = 0; p < sizeof(primitives) / sizeof(primitives[0]); p++) {
+            known |= strcmp(argv[k], primitives[p].name) == 0;
+        }
+        if (!known) {
+            errx(EXIT_FAILURE, "error: unknown primitive '%s'", argv[k]);
+        }
+    }
+
+    printf("%-16s %5s %5s %12s %14s\n", "primitive", "size", "fill", "ns/call", "calls/s");
+    for (size_t p = 0; p < sizeof(primitives) / sizeof(primitives[0]); p++) {
+        if (!selected(primitives[p].name, argv + optind, argc - optind)) {
+            continue;
+        }
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            if (only_size != 0 && sizes[s] != only_size) {
+                continue;
+            }
+            for (size_t f = 0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+                if ((primitives[p].need_empty && fills[f] == 100) || (primitives[p].need_filled && fills[f] == 0)) {
+                    continue;
+                }
+                grid_build(&g, sizes[s], fills[f]);
+                ns = measure(&primitives[p], &g, target);
+                printf("%-16s %5d %4d%% %12.1f %14.0f\n", primitives[p].name, sizes[s], fills[f], ns, 1e9 / ns);
+                fflush(stdout);
+                grid_free(&g);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,470 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backtracking.h"
+#include "binary.h"
+#include "euristic.h"
+#include "grid.h"
+#include "parallel.h"
+#include "pool.h"
+#include "stats.h"
+
+/*
+Parallel version of find_solutionALL (the portfolio for find_solution1 is below).
+A subtree of the search is a task: the branch choices from the root grid.
+Each worker has its own copy of the root grid and a deque of tasks. When
+some workers are idle, a worker at a branch pushes the '1' branch in its
+deque before exploring the '0' branch, and takes it back if nobody stole
+it meanwhile. Idle workers steal the oldest tasks (the biggest subtrees).
+*/
+
+typedef struct {
+    int nb;            // number of branch choices from the root
+    choice_t* choices; // the choices, the last one is the branch of the task
+} t_task;
+
+struct s_pool;
+
+typedef struct {
+    t_grid g;
+    choice_t* path; // branch choices from the root to the current node
+    int depth;
+    int nb_sol; // solutions found by this worker, added at the end
+    struct s_pool* pool;
+
+    // deque of tasks: the worker pushes / takes back at the tail, thieves steal at the head
+    pthread_mutex_t lock;
+    t_task** tasks;
+    int head;
+    int tail;
+    int cap;
+} t_worker;
+
+typedef struct s_pool {
+    t_worker* workers;
+    int nb;
+    atomic_int idle; // number of workers without task, the search is over when all are
+    FILE* fd;
+} t_pool;
+
+static t_task* task_new(t_worker* w, choice_t branch) {
+    t_task* task = (t_task*)malloc(sizeof(t_task));
+    if (task == NULL) {
+        perror("task_new");
+        exit(EXIT_FAILURE);
+    }
+    task->nb = w->depth + 1;
+    task->choices = (choice_t*)malloc(sizeof(choice_t) * task->nb);
+    if (task->choices == NULL) {
+        perror("task_new");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(task->choices, w->path, sizeof(choice_t) * w->depth);
+    task->choices[w->depth] = branch;
+    return task;
+}
+
+static void task_free(t_task* task) {
+    free(task->choices);
+    free(task);
+}
+
+static void deque_push(t_worker* w, t_task* task) {
+    pthread_mutex_lock(&w->lock);
+    if (w->tail == w->cap) {
+        // move the tasks back at the beginning, grow if still full
+        memmove(w->tasks, w->tasks + w->head, sizeof(t_task*) * (w->tail - w->head));
+        w->tail -= w->head;
+        w->head = 0;
+        if (w->tail == w->cap) {
+            w->cap *= 2;
+            w->tasks = (t_task**)realloc(w->tasks, sizeof(t_task*) * w->cap);
+            if (w->tasks == NULL) {
+                perror("deque_push");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    w->tasks[w->tail++] = task;
+    pthread_mutex_unlock(&w->lock);
+}
+
+static bool deque_take_back(t_worker* w, t_task* task) {
+    // the tasks pushed after this one are already taken back or stolen
+    bool found = false;
+    pthread_mutex_lock(&w->lock);
+    if (w->tail > w->head && w->tasks[w->tail - 1] == task) {
+        w->tail--;
+        found = true;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return found;
+}
+
+static t_task* deque_steal(t_worker* victim) {
+    // the thief leaves the idle workers while the deque is locked, so the
+    // task is never in a deque nor in a running worker
+    t_task* task = NULL;
+    pthread_mutex_lock(&victim->lock);
+    if (victim->tail > victim->head) {
+        task = victim->tasks[victim->head++];
+        atomic_fetch_sub(&victim->pool->idle, 1);
+    }
+    pthread_mutex_unlock(&victim->lock);
+    return task;
+}
+
+static void explore(t_worker* w) {
+    // same search as find_solutionALL, with the '1' branch given to idle workers
+    t_grid* g = &w->g;
+    uint64_t t = stats_clock();
+    bool consistent = is_consistent(g);
+    bool valid = consistent && is_valid(g);
+    stats_time(TIME_VALIDATION, t);
+
+    if (!consistent) {
+        stats.backtracks++;
+        return;
+    }
+    stats.nodes++;
+    if (valid) {
+        stats.solutions++;
+        w->nb_sol++;
+        if (w->pool->fd != NULL) {
+            // a grid is printed in one block
+            flockfile(w->pool->fd);
+            grid_write(g, w->pool->fd);
+            funlockfile(w->pool->fd);
+        }
+        return;
+    }
+
+    int mark = grid_trail_mark(g);
+    t = stats_clock();
+    apply_propagation(g);
+    stats_time(TIME_PROPAGATION, t);
+
+    if (!is_consistent(g) || is_valid(g)) {
+        explore(w);
+        grid_undo(g, mark);
+        return;
+    }
+
+    t = stats_clock();
+    choice_t choice = grid_choice(g);
+    stats_time(TIME_BRANCHING, t);
+    int branch = grid_trail_mark(g);
+    t_task* task = NULL;
+
+    if (atomic_load(&w->pool->idle) > 0) {
+        choice.choice = '1';
+        task = task_new(w, choice);
+        deque_push(w, task);
+    }
+
+    choice.choice = '0';
+    set_cell(choice.row, choice.column, g, choice.choice);
+    w->path[w->depth++] = choice;
+    stats_descend();
+    explore(w);
+    stats_ascend();
+    w->depth--;
+    grid_undo(g, branch);
+
+    if (task == NULL || deque_take_back(w, task)) {
+        if (task != NULL) {
+            task_free(task);
+        }
+        choice.choice = '1';
+        set_cell(choice.row, choice.column, g, choice.choice);
+        w->path[w->depth++] = choice;
+        stats_descend();
+        explore(w);
+        stats_ascend();
+        w->depth--;
+    }
+    grid_undo(g, mark);
+}
+
+static void task_run(t_worker* w, t_task* task) {
+    // replay the choices of the task on the root grid, then explore the subtree
+    grid_undo(&w->g, 0);
+    for (int k = 0; k < task->nb; k++) {
+        set_cell(task->choices[k].row, task->choices[k].column, &w->g, task->choices[k].choice);
+        w->path[k] = task->choices[k];
+    }
+    w->depth = task->nb;
+    stats.depth = task->nb;
+    task_free(task);
+    explore(w);
+}
+
+static void* worker_run(void* arg) {
+    t_worker* w = (t_worker*)arg;
+    t_pool* pool = w->pool;
+    t_task* task;
+
+    // the first worker starts with the root task, the others are idle
+    while (true) {
+        task = NULL;
+        pthread_mutex_lock(&w->lock);
+        if (w->tail > w->head) {
+            task = w->tasks[--w->tail];
+        }
+        pthread_mutex_unlock(&w->lock);
+
+        if (task == NULL) {
+            atomic_fetch_add(&pool->idle, 1);
+            while (task == NULL) {
+                if (atomic_load(&pool->idle) == pool->nb) {
+                    stats_merge();
+                    pool_flush();
+                    return NULL;
+                }
+                for (int k = 1; k < pool->nb && task == NULL; k++) {
+                    task = deque_steal(&pool->workers[(w - pool->workers + k) % pool->nb]);
+                }
+                if (task == NULL) {
+                    sched_yield();
+                }
+            }
+        }
+        task_run(w, task);
+    }
+}
+
+int find_solutionALL_parallel(t_grid* tosolve, int nb_jobs, FILE* fd) {
+    /*
+    count (and print in fd if not NULL) all the solutions of tosolve with
+    nb_jobs threads, return the number of solutions
+    */
+    t_pool pool;
+    t_grid root;
+    pthread_t threads[MAX_JOBS];
+    int nb_sol = 0;
+
+    if (nb_jobs > MAX_JOBS) {
+        nb_jobs = MAX_JOBS;
+    }
+
+    // the root is propagated once: grid_undo(g, 0) gives back a fixpoint
+    grid_copy(tosolve, &root);
+    apply_propagation(&root);
+    if (!is_consistent(&root)) {
+        grid_free(&root);
+        return 0;
+    }
+
+    pool.nb = nb_jobs;
+    pool.fd = fd;
+    atomic_init(&pool.idle, 0);
+    pool.workers = (t_worker*)malloc(sizeof(t_worker) * nb_jobs);
+    if (pool.workers == NULL) {
+        perror("find_solutionALL_parallel");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int k = 0; k < nb_jobs; k++) {
+        t_worker* w = &pool.workers[k];
+        grid_copy(&root, &w->g);
+        w->path = (choice_t*)malloc(sizeof(choice_t) * root.size * root.size);
+        w->tasks = (t_task**)malloc(sizeof(t_task*) * 16);
+        if (w->path == NULL || w->tasks == NULL) {
+            perror("find_solutionALL_parallel");
+            exit(EXIT_FAILURE);
+        }
+        w->depth = 0;
+        w->nb_sol = 0;
+        w->pool = &pool;
+        w->head = 0;
+        w->tail = 0;
+        w->cap = 16;
+        pthread_mutex_init(&w->lock, NULL);
+    }
+
+    // root task: no choice
+    t_task* first = (t_task*)malloc(sizeof(t_task));
+    if (first == NULL) {
+        perror("find_solutionALL_parallel");
+        exit(EXIT_FAILURE);
+    }
+    first->nb = 0;
+    first->choices = NULL;
+    deque_push(&pool.workers[0], first);
+
+    for (int k = 0; k < nb_jobs; k++) {
+        if (pthread_create(&threads[k], NULL, worker_run, &pool.workers[k]) != 0) {
+            perror("find_solutionALL_parallel");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int k = 0; k < nb_jobs; k++) {
+        pthread_join(threads[k], NULL);
+    }
+
+    for (int k = 0; k < nb_jobs; k++) {
+        t_worker* w = &pool.workers[k];
+        nb_sol += w->nb_sol;
+        grid_free(&w->g);
+        free(w->path);
+        free(w->tasks);
+        pthread_mutex_destroy(&w->lock);
+    }
+    free(pool.workers);
+    grid_free(&root);
+
+    return nb_sol;
+}
+
+/*
+Portfolio version of find_solution1: each thread runs the whole search with
+its own strategy (branching, value order, seed). The first one to find a
+solution, or to end its search without solution, stops the others.
+*/
+
+typedef struct {
+    t_grid g;
+    t_strategy strategy;
+    atomic_bool* stop; // shared by the racers
+    bool won;          // this racer stopped the others
+    bool has_sol;
+} t_racer;
+
+static void race(t_racer* r) {
+    t_grid* g = &r->g;
+    uint64_t t = stats_clock();
+    bool consistent = is_consistent(g);
+    bool valid = consistent && is_valid(g);
+    stats_time(TIME_VALIDATION, t);
+
+    if (atomic_load(r->stop) || !consistent) {
+        stats.backtracks += !consistent;
+        return;
+    }
+    stats.nodes++;
+    if (valid) {
+        if (!atomic_exchange(r->stop, true)) {
+            stats.solutions++;
+            r->won = true;
+            r->has_sol = true;
+        }
+        return;
+    }
+
+    int mark = grid_trail_mark(g);
+    t = stats_clock();
+    apply_propagation(g);
+    stats_time(TIME_PROPAGATION, t);
+
+    if (!is_consistent(g) || is_valid(g)) {
+        race(r);
+        if (!r->won) {
+            grid_undo(g, mark);
+        }
+        return;
+    }
+
+    t = stats_clock();
+    choice_t choice = grid_choice_strategy(g, &r->strategy);
+    stats_time(TIME_BRANCHING, t);
+    int branch = grid_trail_mark(g);
+
+    stats_descend();
+    set_cell(choice.row, choice.column, g, choice.choice);
+    race(r);
+
+    // the solution stays in the grid of the winner
+    if (r->won) {
+        return;
+    }
+    grid_undo(g, branch);
+
+    choice.choice = choice.choice == '0' ? '1' : '0';
+    set_cell(choice.row, choice.column, g, choice.choice);
+    race(r);
+    if (r->won) {
+        return;
+    }
+    stats_ascend();
+    grid_undo(g, mark);
+}
+
+static void* racer_run(void* arg) {
+    t_racer* r = (t_racer*)arg;
+    race(r);
+
+    // the whole search is done without being stopped: there is no solution
+    if (!r->won && !atomic_exchange(r->stop, true)) {
+        r->won = true;
+        r->has_sol = false;
+    }
+    stats_merge();
+    pool_flush();
+    return NULL;
+}
+
+t_grid* find_solution1_parallel(t_grid* tosolve, int nb_jobs) {
+    /*
+    return a solution of tosolve (to free with grid_free and free) found by
+    the first of nb_jobs searches, or NULL if there is no solution
+    */
+    t_racer* racers;
+    pthread_t threads[MAX_JOBS];
+    atomic_bool stop;
+    t_grid* sol = NULL;
+
+    if (nb_jobs > MAX_JOBS) {
+        nb_jobs = MAX_JOBS;
+    }
+    atomic_init(&stop, false);
+    racers = (t_racer*)malloc(sizeof(t_racer) * nb_jobs);
+    if (racers == NULL) {
+        perror("find_solution1_parallel");
+        exit(EXIT_FAILURE);
+    }
+
+    // racer 0 is the sequential search (with the global branching), the next ones rotate the other strategies
+    for (int k = 0; k < nb_jobs; k++) {
+        t_racer* r = &racers[k];
+        grid_copy(tosolve, &r->g);
+        r->strategy.branching = (t_branching)((branching + k) % NB_BRANCHING);
+        r->strategy.one_first = (k / NB_BRANCHING) % 2 == 1;
+        r->strategy.random_value = k >= 2 * NB_BRANCHING;
+        r->strategy.seed = rand();
+        r->stop = &stop;
+        r->won = false;
+        r->has_sol = false;
+    }
+
+    for (int k = 0; k < nb_jobs; k++) {
+        if (pthread_create(&threads[k], NULL, racer_run, &racers[k]) != 0) {
+            perror("find_solution1_parallel");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int k = 0; k < nb_jobs; k++) {
+        pthread_join(threads[k], NULL);
+    }
+
+    for (int k = 0; k < nb_jobs; k++) {
+        if (racers[k].won && racers[k].has_sol) {
+            sol = (t_grid*)malloc(sizeof(t_grid));
+            if (sol == NULL) {
+                perror("find_solution1_parallel");
+                exit(EXIT_FAILURE);
+            }
+            grid_copy(&racers[k].g, sol);
+            if (verbose) {
+                printf("verbose: solution found by the search %d\n", k);
+            }
+        }
+        grid_free(&racers[k].g);
+    }
+    free(racers);
+    return sol;
+}
@@ -0,0 +1,163 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "grid.h"
+#include "parity.h"
+
+static void* parity_malloc(size_t size) {
+    void* p = malloc(size);
+    if (p == NULL) {
+        perror("parity_allocate");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+void parity_allocate(t_grid* g) {
+    // every cell starts alone in its class, the classes of a grid of the pool (g->parity not NULL) are only reset
+    int nb = g->size * g->size;
+    t_parity* p = g->parity;
+
+    if (p == NULL) {
+        p = (t_parity*)parity_malloc(sizeof(t_parity));
+        p->parent = (int*)parity_malloc(sizeof(int) * nb);
+        p->parity = (unsigned char*)parity_malloc(sizeof(unsigned char) * nb);
+        p->class_size = (int*)parity_malloc(sizeof(int) * nb);
+        p->next = (int*)parity_malloc(sizeof(int) * nb);
+        p->trail_cap = 4 * g->size;
+        p->trail = (t_parity_save*)parity_malloc(sizeof(t_parity_save) * p->trail_cap);
+    }
+    for (int c = 0; c < nb; c++) {
+        p->parent[c] = c;
+        p->parity[c] = 0;
+        p->class_size[c] = 1;
+        p->next[c] = c;
+    }
+    memset(p->row_linked, 0, sizeof(p->row_linked));
+    memset(p->col_linked, 0, sizeof(p->col_linked));
+
+    p->trail_len = 0;
+    g->parity = p;
+}
+
+void parity_free(t_grid* g) {
+    if (g->parity == NULL) {
+        return;
+    }
+    free(g->parity->parent);
+    free(g->parity->parity);
+    free(g->parity->class_size);
+    free(g->parity->next);
+    free(g->parity->trail);
+    free(g->parity);
+    g->parity = NULL;
+}
+
+void parity_copy(t_grid* gs, t_grid* gd) {
+    // gd is allocated with the size of gs and has classes, its trail stays empty like its cell trail
+    t_parity* ps = gs->parity;
+    t_parity* pd = gd->parity;
+    int nb = gs->size * gs->size;
+
+    memcpy(pd->parent, ps->parent, sizeof(int) * nb);
+    memcpy(pd->parity, ps->parity, sizeof(unsigned char) * nb);
+    memcpy(pd->class_size, ps->class_size, sizeof(int) * nb);
+    memcpy(pd->next, ps->next, sizeof(int) * nb);
+    memcpy(pd->row_linked, ps->row_linked, sizeof(ps->row_linked));
+    memcpy(pd->col_linked, ps->col_linked, sizeof(ps->col_linked));
+}
+
+static void parity_mark(t_grid* g, int c) {
+    // flip the linked bit of the cell c
+    int n = g->size;
+    g->parity->row_linked[c / n] ^= 1ULL << (c % n);
+    g->parity->col_linked[c % n] ^= 1ULL << (c / n);
+}
+
+void parity_undo(t_grid* g, int mark) {
+    // same rule as domains_undo: the joins with a stamp > mark are split again
+    t_parity* p = g->parity;
+    int child, root, tmp;
+
+    if (p == NULL) {
+        return;
+    }
+    while (p->trail_len > 0 && p->trail[p->trail_len - 1].stamp > mark) {
+        child = p->trail[--p->trail_len].child;
+        root = p->parent[child];
+        p->class_size[root] -= p->class_size[child];
+        tmp = p->next[root];
+        p->next[root] = p->next[child];
+        p->next[child] = tmp;
+        p->parent[child] = child;
+        p->parity[child] = 0;
+        if (p->class_size[root] == 1) {
+            parity_mark(g, root);
+        }
+        if (p->class_size[child] == 1) {
+            parity_mark(g, child);
+        }
+    }
+}
+
+int parity_find(t_grid* g, int c, int* par) {
+    // root of the class of the cell c, *par is 1 if c has the other value of the root
+    t_parity* p = g->parity;
+    int x = 0;
+
+    while (p->parent[c] != c) {
+        x ^= p->parity[c];
+        c = p->parent[c];
+    }
+    *par = x;
+    return c;
+}
+
+int parity_link(t_grid* g, int a, int b, int differ) {
+    /*
+    record that the cells a and b are equal (differ = 0) or opposite (differ = 1)
+    return 1 if two classes are joined, 0 if the relation was already known,
+    -1 if the opposite relation was
+    */
+    t_parity* p = g->parity;
+    int pa, pb, tmp;
+    int ra = parity_find(g, a, &pa);
+    int rb = parity_find(g, b, &pb);
+
+    if (ra == rb) {
+        return (pa ^ pb) == differ ? 0 : -1;
+    }
+    // the smaller class goes under the root of the bigger one
+    if (p->class_size[ra] < p->class_size[rb]) {
+        tmp = ra;
+        ra = rb;
+        rb = tmp;
+    }
+    if (p->class_size[ra] == 1) {
+        parity_mark(g, ra);
+    }
+    if (p->class_size[rb] == 1) {
+        parity_mark(g, rb);
+    }
+    p->parent[rb] = ra;
+    p->parity[rb] = pa ^ pb ^ differ;
+    p->class_size[ra] += p->class_size[rb];
+    tmp = p->next[ra];
+    p->next[ra] = p->next[rb];
+    p->next[rb] = tmp;
+
+    if (p->trail_len == p->trail_cap) {
+        p->trail_cap *= 2;
+        p->trail = (t_parity_save*)realloc(p->trail, sizeof(t_parity_save) * p->trail_cap);
+        if (p->trail == NULL) {
+            perror("parity_link");
+            exit(EXIT_FAILURE);
+        }
+    }
+    p->trail[p->trail_len].stamp = g->trail_len;
+    p->trail[p->trail_len].child = rb;
+    p->trail_len++;
+    return 1;
+}
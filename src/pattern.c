@@ -0,0 +1,295 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitboard.h"
+#include "grid.h"
+#include "pattern.h"
+
+// valid lines of each size up to PATTERN_MAX_SIZE, all built once by the first grid (several threads allocate grids)
+static uint64_t* tables[PATTERN_MAX_SIZE + 1];
+static int table_counts[PATTERN_MAX_SIZE + 1];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static bool pattern_is_valid(uint64_t p, int n) {
+    // balanced line without 3 consecutive 0 / 1
+    uint64_t full = line_full_mask(n);
+    return line_count(p) == n / 2 && !line_triples(p) && !line_triples(~p & full);
+}
+
+static void pattern_table_build(int n) {
+    uint64_t full = line_full_mask(n);
+    int cpt = 0;
+
+    for (uint64_t p = 0; p <= full; p++) {
+        if (pattern_is_valid(p, n)) {
+            cpt++;
+        }
+    }
+
+    tables[n] = (uint64_t*)malloc(sizeof(uint64_t) * cpt);
+    if (tables[n] == NULL) {
+        perror("pattern_table_build");
+        exit(EXIT_FAILURE);
+    }
+
+    cpt = 0;
+    for (uint64_t p = 0; p <= full; p++) {
+        if (pattern_is_valid(p, n)) {
+            tables[n][cpt++] = p;
+        }
+    }
+    table_counts[n] = cpt;
+}
+
+static void pattern_tables_build(void) {
+    // the grid sizes are powers of 2
+    for (int n = MIN_GRID_SIZE; n <= PATTERN_MAX_SIZE; n *= 2) {
+        pattern_table_build(n);
+    }
+}
+
+void domains_allocate(t_grid* g) {
+    /*
+    every line of the grid starts with all the valid patterns of its size
+    only done for the sizes up to PATTERN_MAX_SIZE, g->domains is NULL otherwise.
+    The domains of a grid of the pool (g->domains not NULL) are only reset:
+    the items of a line are written by its first reduction (domain_filter).
+    */
+    int n = g->size;
+    if (n > PATTERN_MAX_SIZE) {
+        g->domains = NULL;
+        return;
+    }
+    pthread_once(&tables_once, pattern_tables_build);
+
+    t_domains* d = g->domains;
+    if (d == NULL) {
+        d = (t_domains*)malloc(sizeof(t_domains));
+        if (d == NULL) {
+            perror("domains_allocate");
+            exit(EXIT_FAILURE);
+        }
+        d->patterns = tables[n];
+        d->nb_patterns = table_counts[n];
+        d->items = (uint16_t*)malloc(sizeof(uint16_t) * 2 * n * d->nb_patterns);
+        d->trail_cap = 4 * n;
+        d->trail = (t_domain_save*)malloc(sizeof(t_domain_save) * d->trail_cap);
+        if (d->items == NULL || d->trail == NULL) {
+            perror("domains_allocate");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (int line = 0; line < 2 * n; line++) {
+        d->items_size[line] = d->nb_patterns;
+    }
+    d->ready = 0;
+    d->trail_len = 0;
+    g->domains = d;
+}
+
+void domains_free(t_grid* g) {
+    if (g->domains == NULL) {
+        return;
+    }
+    free(g->domains->items);
+    free(g->domains->trail);
+    free(g->domains);
+    g->domains = NULL;
+}
+
+void domains_copy(t_grid* gs, t_grid* gd) {
+    /*
+    gd is allocated with the size of gs, its trail stays empty like its cell trail:
+    the patterns removed from a domain are never given back in gd, only the
+    domains themselves (the first items_size items of a line) are copied
+    */
+    if (gs->domains == NULL) {
+        return;
+    }
+    t_domains* ds = gs->domains;
+    t_domains* dd = gd->domains;
+    for (uint64_t m = ds->ready; m; m &= m - 1) {
+        int line = __builtin_ctzll(m);
+        memcpy(dd->items + line * ds->nb_patterns, ds->items + line * ds->nb_patterns, sizeof(uint16_t) * ds->items_size[line]);
+    }
+    memcpy(dd->items_size, ds->items_size, sizeof(ds->items_size));
+    dd->ready = ds->ready;
+}
+
+static void domain_changed(t_grid* g, int line) {
+    // the score of the line for --branch=patterns (backtracking.c)
+    if (line < g->size) {
+        g->line_dirty_rows |= 1ULL << line;
+    } else {
+        g->line_dirty_cols |= 1ULL << (line - g->size);
+    }
+}
+
+static void domain_save(t_grid* g, int line) {
+    t_domains* d = g->domains;
+    if (d->trail_len == d->trail_cap) {
+        d->trail_cap *= 2;
+        d->trail = (t_domain_save*)realloc(d->trail, sizeof(t_domain_save) * d->trail_cap);
+        if (d->trail == NULL) {
+            perror("domain_save");
+            exit(EXIT_FAILURE);
+        }
+    }
+    d->trail[d->trail_len].stamp = g->trail_len;
+    d->trail[d->trail_len].line = line;
+    d->trail[d->trail_len].size = d->items_size[line];
+    d->trail_len++;
+}
+
+void domains_undo(t_grid* g, int mark) {
+    /*
+    a reduction saved with a stamp <= mark only depends on cells which are
+    still assigned, the later ones are undone: the removed patterns were swapped
+    after the end of the domain, restoring its size gives them back.
+    A line back to all the patterns is written again by its next reduction
+    (its first one only wrote the patterns kept).
+    */
+    t_domains* d = g->domains;
+    t_domain_save* s;
+    if (d == NULL) {
+        return;
+    }
+    while (d->trail_len > 0 && d->trail[d->trail_len - 1].stamp > mark) {
+        s = &d->trail[--d->trail_len];
+        d->items_size[s->line] = s->size;
+        domain_changed(g, s->line);
+        if (s->size == d->nb_patterns) {
+            d->ready &= ~(1ULL << s->line);
+        }
+    }
+}
+
+static bool domain_filter(t_grid* g, int line, uint64_t filled, uint64_t ones, const t_line_slot* index, uint64_t* all, uint64_t* any) {
+    // remove the patterns of the domain which don't match the line, return false if it is empty
+    t_domains* d = g->domains;
+    uint16_t* items = d->items + line * d->nb_patterns;
+    int size = d->items_size[line];
+    int k = 0;
+    uint16_t tmp;
+    uint64_t p;
+
+    // first reduction of the line: only the patterns kept are written
+    if (!((d->ready >> line) & 1)) {
+        size = 0;
+        for (int q = 0; q < d->nb_patterns; q++) {
+            p = d->patterns[q];
+            if (((p ^ ones) & filled) == 0 && line_index_count(index, p) == 0) {
+                *all &= p;
+                *any |= p;
+                items[size++] = q;
+            }
+        }
+        d->ready |= 1ULL << line;
+        k = size;
+    }
+
+    while (k < size) {
+        p = d->patterns[items[k]];
+        if (((p ^ ones) & filled) == 0 && line_index_count(index, p) == 0) {
+            *all &= p;
+            *any |= p;
+            k++;
+        } else {
+            size--;
+            tmp = items[k];
+            items[k] = items[size];
+            items[size] = tmp;
+        }
+    }
+
+    if (size != d->items_size[line]) {
+        domain_save(g, line);
+        d->items_size[line] = size;
+        domain_changed(g, line);
+    }
+    return size != 0;
+}
+
+static bool line_completions(int n, uint64_t filled, uint64_t ones, const t_line_slot* index, uint64_t* all, uint64_t* any) {
+    // list all the valid completions of a line with few empty cells, return false if there is none
+    uint64_t full = line_full_mask(n);
+    uint64_t empty = full & ~filled;
+    int pos[PATTERN_MAX_EMPTY];
+    int nb_empty = 0;
+    int need = n / 2 - line_count(ones);
+    bool found = false;
+    uint64_t p, c, r;
+
+    for (uint64_t e = empty; e; e &= e - 1) {
+        pos[nb_empty++] = __builtin_ctzll(e);
+    }
+    if (need < 0 || need > nb_empty) {
+        return false;
+    }
+
+    // each subset of need empty cells set to 1 (next subset with Gosper's hack)
+    for (uint64_t s = (1ULL << need) - 1; s < (1ULL << nb_empty);) {
+        p = ones;
+        for (uint64_t b = s; b; b &= b - 1) {
+            p |= 1ULL << pos[__builtin_ctzll(b)];
+        }
+        if (!line_triples(p) && !line_triples(~p & full) && line_index_count(index, p) == 0) {
+            *all &= p;
+            *any |= p;
+            found = true;
+        }
+
+        if (s == 0) {
+            break;
+        }
+        c = s & -s;
+        r = s + c;
+        s = (((r ^ s) >> 2) / c) | r;
+    }
+    return found;
+}
+
+bool pattern_forced(t_grid* g, int k, bool is_row, uint64_t* to_one, uint64_t* to_zero) {
+    /*
+    reduce the domain of the line k (row or column) to the valid patterns which
+    match its cells and are different from the full lines of the grid.
+    The empty cells with the same value in all these patterns are put in
+    to_one / to_zero. Return false if no pattern is left.
+    Above PATTERN_MAX_SIZE, the patterns are the completions of the line
+    when it has at most PATTERN_MAX_EMPTY empty cells.
+    */
+    int n = g->size;
+    uint64_t full = line_full_mask(n);
+    uint64_t filled = is_row ? g->row_filled[k] : g->col_filled[k];
+    uint64_t ones = is_row ? g->row_ones[k] : g->col_ones[k];
+    const t_line_slot* index = is_row ? g->row_index : g->col_index;
+    uint64_t all = full;
+    uint64_t any = 0;
+
+    *to_one = 0;
+    *to_zero = 0;
+    if (filled == full) {
+        return true;
+    }
+
+    if (g->domains != NULL) {
+        if (!domain_filter(g, is_row ? k : n + k, filled, ones, index, &all, &any)) {
+            return false;
+        }
+    } else if (n - line_count(filled) <= PATTERN_MAX_EMPTY) {
+        if (!line_completions(n, filled, ones, index, &all, &any)) {
+            return false;
+        }
+    } else {
+        return true;
+    }
+
+    *to_one = all & ~filled;
+    *to_zero = ~any & full & ~filled;
+    return true;
+}
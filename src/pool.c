@@ -0,0 +1,224 @@
+#include <err.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "grid.h"
+#include "parity.h"
+#include "pattern.h"
+#include "pool.h"
+
+/*
+Pool of the buffers of the grids: grid_free gives the block of a grid back
+to the free list of its size and grid_allocate takes it again, so the
+searches, the generator and the batches stop calling malloc once they have
+as many blocks as grids alive at the same time.
+The free lists are kept by each thread without lock: a block freed by the
+thread which allocated it is taken again by this thread. The lock is only
+taken when a block crosses threads (freed by another thread, it goes to the
+shared lists), when the lists of the thread are empty, by pool_flush which
+gives the blocks of a thread to the shared lists before its end, and by
+pool_clear.
+An arena of a thread records the blocks allocated by this thread since
+arena_begin (they are freed by this thread): arena_end gives back at once
+the ones not freed yet (the grids of a solve), arena_keep takes out a grid
+which outlives it (a solution).
+The grids of the blocks given back by arena_end must not be used anymore:
+each release of a block counts a use, grid_free of such a grid stops the
+program because its count doesn't match the one of its block.
+*/
+
+static t_block* shared_blocks[MAX_GRID_SIZE + 1];
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local t_block* free_blocks[MAX_GRID_SIZE + 1];
+static _Thread_local t_arena* current = NULL;
+static _Thread_local char thread_tag; // its address tells the threads apart
+
+static t_block* block_new(int n) {
+    // the probe keys, the row pointers and the cells follow the block (multiples of 8 bytes)
+    t_block* b = (t_block*)malloc(sizeof(t_block) + sizeof(uint64_t) * n * n + sizeof(char*) * n + n * n);
+    if (b == NULL) {
+        perror("grid_allocate");
+        exit(EXIT_FAILURE);
+    }
+    b->size = n;
+    b->probe_key = (uint64_t*)(b + 1);
+    b->grid = (char**)(b->probe_key + n * n);
+    for (int i = 0; i < n; i++) {
+        b->grid[i] = (char*)(b->grid + n) + i * n;
+    }
+
+    // a cell is assigned at most once along a search path
+    b->trail_cap = n * n;
+    b->trail = (int*)malloc(sizeof(int) * b->trail_cap);
+    if (b->trail == NULL) {
+        perror("grid_allocate");
+        exit(EXIT_FAILURE);
+    }
+    b->domains = NULL;
+    b->parity = NULL;
+    b->uses = 0;
+    return b;
+}
+
+static void arena_unlink(t_block* b) {
+    // b is in an arena of this thread, or in none
+    if (b->arena == NULL) {
+        return;
+    }
+    if (b->prev != NULL) {
+        b->prev->next = b->next;
+    } else {
+        b->arena->blocks = b->next;
+    }
+    if (b->next != NULL) {
+        b->next->prev = b->prev;
+    }
+    b->arena = NULL;
+}
+
+static void block_release(t_block* b) {
+    // b is not in an arena, its grid is not allocated anymore
+    b->uses++;
+    if (b->thread != &thread_tag) {
+        pthread_mutex_lock(&pool_lock);
+        b->next = shared_blocks[b->size];
+        shared_blocks[b->size] = b;
+        pthread_mutex_unlock(&pool_lock);
+        return;
+    }
+    b->next = free_blocks[b->size];
+    free_blocks[b->size] = b;
+}
+
+void pool_get(t_grid* g, int n) {
+    // the buffers of g (size n), cleared: empty cells, probe keys to 0, initial domains
+    t_block* b = free_blocks[n];
+
+    if (b != NULL) {
+        free_blocks[n] = b->next;
+    } else {
+        pthread_mutex_lock(&pool_lock);
+        b = shared_blocks[n];
+        if (b != NULL) {
+            shared_blocks[n] = b->next;
+        }
+        pthread_mutex_unlock(&pool_lock);
+        if (b == NULL) {
+            b = block_new(n);
+        }
+    }
+
+    b->thread = &thread_tag;
+    b->arena = current;
+    b->prev = NULL;
+    b->next = NULL;
+    if (current != NULL) {
+        b->next = current->blocks;
+        if (b->next != NULL) {
+            b->next->prev = b;
+        }
+        current->blocks = b;
+    }
+
+    memset(b->probe_key, 0, sizeof(uint64_t) * n * n);
+    memset(b->grid[0], '_', n * n);
+    g->block = b;
+    g->block_uses = b->uses;
+    g->probe_key = b->probe_key;
+    g->grid = b->grid;
+    g->trail = b->trail;
+    g->trail_cap = b->trail_cap;
+    g->domains = b->domains;
+    domains_allocate(g);
+    b->domains = g->domains;
+    // the classes are only used by --propagate=parity and probe, see pool_parity
+    g->parity = NULL;
+}
+
+void pool_parity(t_grid* g) {
+    // the classes of g, first used by the propagation: the ones of its block, reset
+    t_block* b = g->block;
+
+    g->parity = b->parity;
+    parity_allocate(g);
+    b->parity = g->parity;
+}
+
+void pool_put(t_grid* g) {
+    // the block of g back in the pool of this thread, g is not allocated anymore
+    t_block* b = g->block;
+
+    if (g->block_uses != b->uses) {
+        errx(EXIT_FAILURE, "error: grid_free: the grid was given back by the end of its arena");
+    }
+    arena_unlink(b);
+    block_release(b);
+    g->block = NULL;
+}
+
+void pool_flush(void) {
+    // give the free blocks of this thread to the shared lists, before the end of the thread
+    t_block* b;
+
+    pthread_mutex_lock(&pool_lock);
+    for (int n = 0; n <= MAX_GRID_SIZE; n++) {
+        while (free_blocks[n] != NULL) {
+            b = free_blocks[n];
+            free_blocks[n] = b->next;
+            b->next = shared_blocks[n];
+            shared_blocks[n] = b;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void pool_clear(void) {
+    // free the free blocks of this thread and of the shared lists, the grids still allocated keep theirs
+    t_block* b;
+    t_grid g;
+
+    pool_flush();
+    pthread_mutex_lock(&pool_lock);
+    for (int n = 0; n <= MAX_GRID_SIZE; n++) {
+        while (shared_blocks[n] != NULL) {
+            b = shared_blocks[n];
+            shared_blocks[n] = b->next;
+            g.domains = b->domains;
+            g.parity = b->parity;
+            domains_free(&g);
+            parity_free(&g);
+            free(b->trail);
+            free(b);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void arena_begin(t_arena* a) {
+    // the grids allocated by this thread until arena_end are recorded in a
+    a->blocks = NULL;
+    a->prev = current;
+    current = a;
+}
+
+void arena_keep(t_grid* g) {
+    // g stays allocated after the end of its arena
+    arena_unlink(g->block);
+}
+
+void arena_end(t_arena* a) {
+    // give back the blocks of the grids of a not freed yet, these grids must not be used anymore
+    t_block* b;
+
+    while (a->blocks != NULL) {
+        b = a->blocks;
+        a->blocks = b->next;
+        b->arena = NULL;
+        block_release(b);
+    }
+    current = a->prev;
+}
@@ -0,0 +1,79 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "stats.h"
+
+/*
+Each thread counts in its own t_stats (no sharing in the search), a search
+thread adds its counters to the total before it ends, the main thread at
+the end of the run. The times of the parts are summed over the threads.
+*/
+
+_Thread_local t_stats stats;
+bool stats_timing = false;
+
+static const char* rule_names[NB_RULES] = {"consec", "middle", "complete", "windows", "parity", "patterns", "probe"};
+static const char* part_names[NB_TIMES] = {"propagation", "branching", "validation"};
+
+static t_stats total;
+static pthread_mutex_t total_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec start;
+
+void stats_start(void) {
+    // start of the run, for the rates of stats_print
+    clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+void stats_merge(void) {
+    pthread_mutex_lock(&total_lock);
+    total.nodes += stats.nodes;
+    total.solutions += stats.solutions;
+    total.backtracks += stats.backtracks;
+    total.checks += stats.checks;
+    for (int r = 0; r < NB_RULES; r++) {
+        total.forced[r] += stats.forced[r];
+    }
+    for (int p = 0; p < NB_TIMES; p++) {
+        total.time[p] += stats.time[p];
+    }
+    if (stats.max_depth > total.max_depth) {
+        total.max_depth = stats.max_depth;
+    }
+    pthread_mutex_unlock(&total_lock);
+    memset(&stats, 0, sizeof(stats));
+}
+
+static void stats_json(FILE* fd, double wall) {
+    // all the counters in one JSON object, the times in seconds, the peak memory (resident) in kilobytes
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(fd, "{\"nodes\": %lu, \"solutions\": %lu, \"backtracks\": %lu, \"max_depth\": %u, \"consistency_checks\": %lu, ", total.nodes, total.solutions, total.backtracks, total.max_depth, total.checks);
+    fprintf(fd, "\"forced\": {");
+    for (int r = 0; r < NB_RULES; r++) {
+        fprintf(fd, "%s\"%s\": %lu", r > 0 ? ", " : "", rule_names[r], total.forced[r]);
+    }
+    fprintf(fd, "}, \"time\": {\"wall\": %.6f", wall);
+    for (int p = 0; p < NB_TIMES; p++) {
+        fprintf(fd, ", \"%s\": %.6f", part_names[p], total.time[p] * 1e-9);
+    }
+    fprintf(fd, "}, \"peak_memory_kb\": %ld}\n", usage.ru_maxrss);
+}
+
+void stats_print(FILE* fd, bool json) {
+    // the counters of all the threads, in one line with their rate over the wall time of the run or in JSON
+    struct timespec end;
+    double wall;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    stats_merge();
+    if (json) {
+        stats_json(fd, wall);
+        return;
+    }
+    fprintf(fd, "stats: %lu nodes, %lu solutions, %.6fs, %.0f nodes/s, %.0f solutions/s\n", total.nodes, total.solutions, wall, total.nodes / wall, total.solutions / wall);
+}
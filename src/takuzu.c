@@ -8,35 +8,59 @@
 #include <unistd.h>
 
 #include "backtracking.h"
+#include "batch.h"
+#include "binary.h"
+#include "cdcl.h"
 #include "euristic.h"
+#include "generator.h"
 #include "grid.h"
+#include "parallel.h"
+#include "pool.h"
+#include "stats.h"
 #include "takuzu.h"
+#include "trace.h"
 #include "utils.h"
 
 bool verbose = 0;
 
 int main(int argc, char* argv[]) {
     srand(time(NULL));
-    bool all = false, unique = false, g_mode = false, i_flag = false, o_flag = false;
+    bool all = false, unique = false, g_mode = false, i_flag = false, o_flag = false, full = false, cdcl = false, convert = false, show_stats = false, json_stats = false;
     t_grid g;
 
     static struct option long_options[] = {
-        {    "help",       no_argument, NULL, 'h'},
-        {     "all",       no_argument, NULL, 'a'},
-        { "verbose",       no_argument, NULL, 'v'},
-        {"generate", optional_argument, NULL, 'g'},
-        {  "output", optional_argument, NULL, 'o'},
-        {  "unique",       no_argument, NULL, 'u'},
-        {      NULL,                 0, NULL,   0}  // the end of the struct
+        {      "help",       no_argument, NULL, 'h'},
+        {       "all",       no_argument, NULL, 'a'},
+        {   "verbose",       no_argument, NULL, 'v'},
+        {  "generate", optional_argument, NULL, 'g'},
+        {    "output", optional_argument, NULL, 'o'},
+        {    "unique",       no_argument, NULL, 'u'},
+        {      "jobs", required_argument, NULL, 'j'},
+        {      "full",       no_argument, NULL, 'f'},
+        {    "search", required_argument, NULL, 's'},
+        { "propagate", required_argument, NULL, 'p'},
+        {    "branch", required_argument, NULL, 'b'},
+        {    "format", required_argument, NULL, 'F'},
+        {   "convert",       no_argument, NULL, 'c'},
+        {      "grid", required_argument, NULL, 'k'},
+        {     "stats", optional_argument, NULL, 'S'},
+        {      "seed", required_argument, NULL, 'r'},
+        {     "trace", required_argument, NULL, 't'},
+        {"dig-budget", required_argument, NULL, 'd'},
+        {        NULL,                 0, NULL,   0}  // the end of the struct
     };
 
     int opt;
     char size_grid = 8; // use of char because the grid max size is 64
+    int nb_jobs = 1;    // number of threads of the solver
+    long grid_k = 0;    // grid of the input FILE to solve, from 1 (0: all of them)
+    long start = -1;    // header of the binary output
     char o_file[256];
     char i_file[256];
+    char t_file[256] = ""; // trace of the search (--trace), empty if there is none
     FILE* fd_output = NULL; // the file where the solution will be written
 
-    while ((opt = getopt_long(argc, argv, "havg:o:u", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "havg:o:uj:", long_options, NULL)) != -1) {
         switch (opt) {
             case 'h': // HELP
                 display_help(argv[0]);
@@ -57,6 +81,87 @@ int main(int argc, char* argv[]) {
             case 'u': // UNIQUE OPTION
                 unique = true;
                 break;
+            case 'j': // JOBS OPTION
+                nb_jobs = atoi(optarg);
+                if (nb_jobs < 1 || nb_jobs > MAX_JOBS) {
+                    warnx("warning: invalid number of jobs, using 1 thread!");
+                    nb_jobs = 1;
+                }
+                break;
+            case 's': // SEARCH OPTION
+                if (strcmp(optarg, "cdcl") == 0) {
+                    cdcl = true;
+                } else if (strcmp(optarg, "backtrack") != 0) {
+                    warnx("warning: unknown search '%s', using backtrack!", optarg);
+                }
+                break;
+            case 'p': // PROPAGATION LEVEL
+                if (strcmp(optarg, "probe") == 0) {
+                    propagation = PROPAGATE_PROBE;
+                } else if (strcmp(optarg, "parity") == 0) {
+                    propagation = PROPAGATE_PARITY;
+                } else if (strcmp(optarg, "basic") != 0) {
+                    warnx("warning: unknown propagation '%s', using basic!", optarg);
+                }
+                break;
+            case 'b': // BRANCHING HEURISTIC
+                if (strcmp(optarg, "line") == 0) {
+                    branching = BRANCH_LINE;
+                } else if (strcmp(optarg, "patterns") == 0) {
+                    branching = BRANCH_PATTERNS;
+                } else if (strcmp(optarg, "activity") == 0) {
+                    branching = BRANCH_ACTIVITY;
+                } else if (strcmp(optarg, "around") != 0) {
+                    warnx("warning: unknown branching '%s', using around!", optarg);
+                }
+                break;
+            case 'F': // OUTPUT FORMAT
+                if (strcmp(optarg, "bin") == 0) {
+                    format = FORMAT_BIN;
+                } else if (strcmp(optarg, "line") == 0) {
+                    format = FORMAT_LINE;
+                } else if (strcmp(optarg, "text") != 0) {
+                    warnx("warning: unknown format '%s', using text!", optarg);
+                }
+                break;
+            case 'c': // CONVERT OPTION
+                convert = true;
+                break;
+            case 'k': // GRID OF THE INPUT FILE
+                grid_k = atol(optarg);
+                if (grid_k < 1) {
+                    warnx("warning: invalid grid number, solving all the grids!");
+                    grid_k = 0;
+                }
+                break;
+            case 'S': // STATISTICS OPTION
+                show_stats = true;
+                if (optarg != NULL && strcmp(optarg, "json") == 0) {
+                    json_stats = true;
+                    stats_timing = true;
+                } else if (optarg != NULL && strcmp(optarg, "text") != 0) {
+                    warnx("warning: unknown stats format '%s', using text!", optarg);
+                }
+                break;
+            case 'r': // SEED OPTION
+                srand(atoi(optarg));
+                break;
+            case 'd': // BUDGET OF THE UNIQUENESS TESTS
+                dig_budget = atol(optarg);
+                if (dig_budget < 1) {
+                    warnx("warning: invalid dig budget, using exact tests!");
+                    dig_budget = 0;
+                }
+                break;
+            case 't': // TRACE FILE
+                if (strlen(optarg) >= 256) {
+                    errx(EXIT_FAILURE, "error: --trace FILE: filename with too many characters");
+                }
+                strcpy(t_file, optarg);
+                break;
+            case 'f': // FULL OPTION
+                full = true;
+                break;
             case 'g': // GENERATION MODE
                 g_mode = true;
                 if (!optarg) {
@@ -74,6 +179,8 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    stats_start();
+
     // If not in generation mode then verify the FILE to use in input
 
     if (optind < argc) {
@@ -100,6 +207,11 @@ int main(int argc, char* argv[]) {
         warnx("warning: no -o option, using standard output");
         fd_output = stdout;
     }
+    // the messages of -v go to the standard output, they would be mixed with the binary grids
+    if (verbose && format == FORMAT_BIN && fd_output == stdout) {
+        warnx("warning: option 'verbose' conflict with binary output on standard output, disabling it!");
+        verbose = false;
+    }
 
     if (g_mode) {
         if (all) {
@@ -111,72 +223,44 @@ int main(int argc, char* argv[]) {
             warnx("info: executing in generation mode");
         }
 
-        grid_allocate(&g, size_grid);
-        fill_grid(&g);
-
-        t_grid cpy;
-
-        if (unique) {
-            int nb = 0;
-            // Just to have the nb of solution of g
-
-            grid_copy(&g, &cpy);
-
-            find_solutionALL(&cpy, &nb, NULL);
-
-            printf("verbose: generating grid with unique solution...\n");
-
-            // generate grid until it has 1 solution
-            while (nb != 1) {
-                nb = 0;
-
-                grid_free(&cpy);
-                grid_free(&g);
-                grid_allocate(&g, size_grid);
-                fill_grid(&g);
-
-                grid_copy(&g, &cpy);
-                find_solutionALL(&cpy, &nb, NULL);
-            }
-
-            printf("verbose: generation done\n");
-
-            grid_free(&cpy);
-
-            grid_print(&g, fd_output);
-
+        if (full && unique) {
+            warnx("warning: option 'unique' conflict with option 'full', disabling it!");
+            unique = false;
         }
 
-        else {
-            // Just to have the nb of solution of g
-            // We copy the random grid and then try to find solution on it
-            bool has_sol = false;
-            grid_copy(&g, &cpy);
-            find_solution1(&cpy, &has_sol, NULL);
+        grid_allocate(&g, size_grid);
 
+        // the clues are taken from a random complete grid, so the grid always has a solution
+        if (full) {
             if (verbose) {
-                printf("verbose: generating grid with multiple solution...\n");
+                printf("verbose: generating complete grid...\n");
             }
-
-            // generate grid until it has 1 solution
-            while (has_sol == false) {
-                grid_free(&g);
-                grid_free(&cpy);
-
-                grid_allocate(&g, size_grid);
-                fill_grid(&g);
-                grid_copy(&g, &cpy);
-
-                find_solution1(&cpy, &has_sol, NULL);
+            generate_full(&g);
+        } else if (unique) {
+            if (verbose) {
+                printf("verbose: generating grid with unique solution...\n");
             }
-
-            grid_free(&cpy);
-
+            generate_unique(&g);
+        } else {
             if (verbose) {
-                printf("verbose: generation done\n");
+                printf("verbose: generating grid with multiple solution...\n");
             }
+            generate_clues(&g, N);
+        }
+
+        if (verbose) {
+            printf("verbose: generation done\n");
+        }
 
-            grid_print(&g, fd_output);
+        if (format == FORMAT_BIN) {
+            if (fd_output == stdout) {
+                warnx("info: the grid is written on standard output as a binary file (--format=bin)");
+            }
+            start = binary_begin(fd_output, g.size);
+            grid_write(&g, fd_output);
+            binary_end(fd_output, start, g.size);
+        } else {
+            grid_write(&g, fd_output);
         }
 
         // Doing some stuff about generation mode
@@ -185,37 +269,113 @@ int main(int argc, char* argv[]) {
             warnx("warning: option 'unique' conflict with solver mode, disabling it!");
             unique = false;
         }
-
+        if (full) {
+            warnx("warning: option 'full' is only used in generation mode, disabling it!");
+            full = false;
+        }
         if (!i_flag) {
             errx(EXIT_FAILURE, "error: no input grid given!");
         }
 
-        file_parser(&g, i_file);
+        if (convert) {
+            convert_files(argv + optind, argc - optind, fd_output);
+            warnx("info: executing in conversion mode");
+            pool_clear();
+            return 0;
+        }
+
+        // several files or a corpus of grids: the threads of -j solve different grids, each one with 1 thread
+        bool batch = argc - optind > 1;
+        if (batch && grid_k > 0) {
+            warnx("warning: option 'grid' needs only one input FILE, disabling it!");
+            grid_k = 0;
+        }
+        if (!batch && file_parser(&g, i_file, grid_k > 0 ? grid_k - 1 : 0) && grid_k == 0) {
+            grid_free(&g);
+            batch = true;
+        }
+        if (cdcl && (all || (nb_jobs > 1 && !batch))) {
+            warnx("warning: search 'cdcl' only looks for the first solution with 1 thread, using backtrack!");
+            cdcl = false;
+        }
+        if (t_file[0] != '\0' && (batch || nb_jobs > 1 || cdcl)) {
+            warnx("warning: option 'trace' needs one grid solved by backtrack with 1 thread, disabling it!");
+            t_file[0] = '\0';
+        }
+
+        // the solver threads would print their choices in the middle of the ordered output of the grids
+        if (batch && verbose) {
+            warnx("warning: option 'verbose' conflict with batch mode, disabling it!");
+            verbose = false;
+        }
+
+        if (batch) {
+            batch_solve(argv + optind, argc - optind, nb_jobs, all, cdcl, fd_output);
+            warnx("info: executing in solver mode");
+            if (show_stats) {
+                stats_print(stderr, json_stats);
+            }
+            pool_clear();
+            return 0;
+        }
 
         if (verbose) {
             printf("verbose: trying to find solution for :\n");
             grid_print(&g, NULL);
         }
-        if (all) {
+        // the binary output only holds the solutions, the messages are left to the text output
+        if (format == FORMAT_BIN) {
+            start = binary_begin(fd_output, g.size);
+        }
+        if (t_file[0] != '\0') {
+            trace_open(t_file, g.size);
+        }
+        if (all && nb_jobs > 1) {
+            int nb_sol = find_solutionALL_parallel(&g, nb_jobs, fd_output);
+            if (format != FORMAT_BIN) {
+                fprintf(fd_output, "Number of solutions : %d\n", nb_sol);
+            }
+        } else if (all) {
             grid_solver(&g, MODE_ALL, fd_output);
         } else {
-            t_grid* sol = grid_solver(&g, MODE_FIRST, fd_output);
-            if (sol == NULL) {
+            t_grid* sol;
+            if (cdcl) {
+                sol = find_solution_cdcl(&g);
+            } else if (nb_jobs > 1) {
+                sol = find_solution1_parallel(&g, nb_jobs);
+            } else {
+                sol = grid_solver(&g, MODE_FIRST, fd_output);
+            }
+            if (sol == NULL && format == FORMAT_BIN) {
+                warnx("warning: no solution for the input grid");
+            } else if (sol == NULL) {
                 // no solution
                 fprintf(fd_output, "No solution for the input grid\n");
+            } else if (format == FORMAT_BIN) {
+                grid_write(sol, fd_output);
             } else {
                 // 1 solution
                 fprintf(fd_output, "found a solution for the input grid :\n\n");
-                grid_print(sol, fd_output);
+                grid_write(sol, fd_output);
+            }
+            if (sol != NULL) {
+                grid_free(sol);
+                free(sol);
             }
-            grid_free(sol);
-            free(sol);
         }
+        if (format == FORMAT_BIN) {
+            binary_end(fd_output, start, g.size);
+        }
+        trace_close();
 
         warnx("info: executing in solver mode");
         // Doing some stuff about solver mode
     }
 
+    if (show_stats) {
+        stats_print(stderr, json_stats);
+    }
     grid_free(&g);
+    pool_clear();
     return 0;
 }
@@ -0,0 +1,99 @@
+#include <err.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "grid.h"
+#include "stats.h"
+#include "trace.h"
+
+/*
+Trace of the search tree of find_solution1 / find_solutionALL: a header of
+TRACE_HEADER bytes then one record of TRACE_RECORD bytes per node, in the
+order of the search (depth first), so the parent of a node is the last node
+before it with a lower depth. A node is the root or a branch (a cell and its
+value), recorded once its propagation is done: the number of cells set by the
+propagation, failed if the grid is then inconsistent, solution if it is
+complete. The records go through a buffer, written when it is full.
+*/
+
+#define TRACE_BUFFER (1 << 16)
+
+FILE* trace_fd = NULL;
+
+static uint8_t buffer[TRACE_BUFFER];
+static size_t len;
+static bool pending; // a branch is set and not recorded yet
+static int pending_cell;
+static char pending_value;
+static unsigned int pending_depth;
+
+static void put16(uint8_t* p, unsigned int v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void trace_flush(void) {
+    if (fwrite(buffer, 1, len, trace_fd) != len) {
+        perror("trace");
+        exit(EXIT_FAILURE);
+    }
+    len = 0;
+}
+
+void trace_open(const char* file, int n) {
+    // start the trace of the search of a grid of size n, its root is the next node
+    uint8_t h[TRACE_HEADER] = {0};
+
+    trace_fd = fopen(file, "wb");
+    if (trace_fd == NULL) {
+        perror("Error while opening trace file");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(h, TRACE_MAGIC, 4);
+    h[4] = TRACE_VERSION;
+    h[5] = (uint8_t)n;
+    fwrite(h, 1, TRACE_HEADER, trace_fd);
+    len = 0;
+    trace_set_branch(TRACE_ROOT, '_');
+}
+
+void trace_close(void) {
+    if (trace_fd == NULL) {
+        return;
+    }
+    trace_flush();
+    fclose(trace_fd);
+    trace_fd = NULL;
+}
+
+void trace_set_branch(int cell, char v) {
+    // the branch is at the current depth of the search (stats.depth)
+    pending = true;
+    pending_cell = cell;
+    pending_value = v;
+    pending_depth = stats.depth;
+}
+
+void trace_write_node(t_grid* g, int mark) {
+    // nothing if the last branch is already recorded (a node without branch after its propagation)
+    uint8_t* r;
+
+    if (!pending) {
+        return;
+    }
+    pending = false;
+    if (len + TRACE_RECORD > TRACE_BUFFER) {
+        trace_flush();
+    }
+    r = buffer + len;
+    put16(r, pending_depth);
+    put16(r + 2, pending_cell);
+    put16(r + 4, grid_trail_mark(g) - mark);
+    r[6] = pending_value == '_' ? 2 : pending_value == '1';
+    // not is_consistent, the trace does not change the counts of --stats
+    r[7] = !grid_consistent(g) ? TRACE_FAILED : g->nb_filled == g->size * g->size ? TRACE_SOLUTION : 0;
+    len += TRACE_RECORD;
+}
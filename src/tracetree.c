@@ -0,0 +1,168 @@
+#include <err.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+/*
+Reader of the traces of takuzu --trace=TRACE (trace.c): a summary of the
+search tree by depth (nodes, dead ends, solutions, cells propagated and
+size of the subtrees), or the tree in DOT with -d. The subtree of a node
+ends at the next node of the same or a lower depth, so a stack of the
+nodes of the current branch is enough to count the subtrees.
+*/
+
+#define MAX_DEPTH 65536 // depths of 16 bits
+
+typedef struct {
+    unsigned long id;      // number of the node in the trace
+    unsigned long subtree; // nodes of its subtree read so far
+} t_open;
+
+typedef struct {
+    unsigned long nodes, failed, solutions, propagated, subtrees;
+} t_level;
+
+static unsigned int get16(const uint8_t* p) {
+    return p[0] | p[1] << 8;
+}
+
+static void usage(char* prog) {
+    printf("Usage:\t%s [-d [-m DEPTH]] TRACE\n", prog);
+    printf("Summary by depth of the search tree written by takuzu --trace=TRACE\n");
+    printf("-d write the tree in DOT instead (red: dead end, green: solution)\n");
+    printf("-m DEPTH only the nodes up to this depth in DOT\n");
+    printf("-h display this help and exit\n");
+}
+
+static void dot_node(unsigned long id, const uint8_t* r, int n, bool has_parent, unsigned long parent) {
+    unsigned int cell = get16(r + 2);
+    const char* color = r[7] & TRACE_FAILED ? ", color=red" : r[7] & TRACE_SOLUTION ? ", color=green" : "";
+
+    if (cell == TRACE_ROOT) {
+        printf("    n%lu [label=\"root\\n+%u\"%s];\n", id, get16(r + 4), color);
+    } else {
+        printf("    n%lu [label=\"(%u, %u) = %u\\n+%u\"%s];\n", id, cell / n, cell % n, r[6], get16(r + 4), color);
+    }
+    if (has_parent) {
+        printf("    n%lu -> n%lu;\n", parent, id);
+    }
+}
+
+static void summary(const t_level* levels, unsigned int max_depth) {
+    unsigned long nodes = 0, failed = 0, solutions = 0;
+
+    for (unsigned int d = 0; d <= max_depth; d++) {
+        nodes += levels[d].nodes;
+        failed += levels[d].failed;
+        solutions += levels[d].solutions;
+    }
+    printf("%lu nodes, %lu dead ends, %lu solutions, depth %u\n", nodes, failed, solutions, max_depth);
+    printf("%5s %10s %10s %10s %12s %12s\n", "depth", "nodes", "dead ends", "solutions", "propag/node", "subtree/node");
+    for (unsigned int d = 0; d <= max_depth; d++) {
+        if (levels[d].nodes == 0) {
+            continue;
+        }
+        printf("%5u %10lu %10lu %10lu %12.1f %12.1f\n", d, levels[d].nodes, levels[d].failed, levels[d].solutions, (double)levels[d].propagated / levels[d].nodes, (double)levels[d].subtrees / levels[d].nodes);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool dot = false;
+    long dot_depth = MAX_DEPTH;
+    int opt, n;
+    uint8_t h[TRACE_HEADER];
+    uint8_t r[TRACE_RECORD];
+    unsigned int depth, max_depth = 0;
+    unsigned long id = 0;
+    int top = -1; // the open nodes are stack[0..top], stack[d] at depth d
+    t_open* stack;
+    t_level* levels;
+    FILE* fd;
+
+    while ((opt = getopt(argc, argv, "hdm:")) != -1) {
+        switch (opt) {
+            case 'd':
+                dot = true;
+                break;
+            case 'm':
+                dot_depth = atol(optarg);
+                break;
+            case 'h':
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    fd = fopen(argv[optind], "rb");
+    if (fd == NULL) {
+        perror(argv[optind]);
+        exit(EXIT_FAILURE);
+    }
+    if (fread(h, 1, TRACE_HEADER, fd) != TRACE_HEADER || memcmp(h, TRACE_MAGIC, 4) != 0 || h[4] != TRACE_VERSION) {
+        errx(EXIT_FAILURE, "error: %s: not a trace of version %d", argv[optind], TRACE_VERSION);
+    }
+    n = h[5];
+
+    stack = (t_open*)malloc(sizeof(t_open) * MAX_DEPTH);
+    levels = (t_level*)calloc(MAX_DEPTH, sizeof(t_level));
+    if (stack == NULL || levels == NULL) {
+        perror("tracetree");
+        exit(EXIT_FAILURE);
+    }
+
+    if (dot) {
+        printf("digraph trace {\n    node [shape=box];\n");
+    }
+    while (fread(r, 1, TRACE_RECORD, fd) == TRACE_RECORD) {
+        depth = get16(r);
+        if ((int)depth > top + 1) {
+            errx(EXIT_FAILURE, "error: %s: node %lu at depth %u without parent", argv[optind], id, depth);
+        }
+        // the subtrees of the nodes of the same or a lower depth are complete
+        for (; top >= (int)depth; top--) {
+            levels[top].subtrees += stack[top].subtree;
+            if (top > 0) {
+                stack[top - 1].subtree += stack[top].subtree;
+            }
+        }
+        if (dot && depth <= dot_depth) {
+            dot_node(id, r, n, depth > 0, depth > 0 ? stack[depth - 1].id : 0);
+        }
+        stack[++top] = (t_open){id++, 1};
+        levels[depth].nodes++;
+        levels[depth].failed += (r[7] & TRACE_FAILED) != 0;
+        levels[depth].solutions += (r[7] & TRACE_SOLUTION) != 0;
+        levels[depth].propagated += get16(r + 4);
+        if (depth > max_depth) {
+            max_depth = depth;
+        }
+    }
+    for (; top >= 0; top--) {
+        levels[top].subtrees += stack[top].subtree;
+        if (top > 0) {
+            stack[top - 1].subtree += stack[top].subtree;
+        }
+    }
+    fclose(fd);
+
+    if (dot) {
+        printf("}\n");
+    } else {
+        summary(levels, max_depth);
+    }
+    free(stack);
+    free(levels);
+    return 0;
+}
@@ -6,13 +6,27 @@
 
 void display_help(char* prog_name) {
     // Display the help when -h option is used
-    printf("Usage:\t%s [-a|-o FILE|-v|-h] FILE...\n", prog_name);
-    printf("\t%s -g[SIZE] [-u|-o FILE|-v|-h]\n", prog_name);
+    printf("Usage:\t%s [-a|-j N|--search=S|--propagate=P|--branch=B|--grid=K|--format=F|--stats[=json]|--trace=TRACE|-o FILE|-v|-h] FILE...\n", prog_name);
+    printf("\t%s --convert [--format=F|-o FILE] FILE...\n", prog_name);
+    printf("\t%s -g[SIZE] [-u|--dig-budget=N|--full|--format=F|--seed=N|--stats[=json]|-o FILE|-v|-h]\n", prog_name);
     printf("Solve or generate takuzu grids of size: 4, 8 16, 32, 64\n");
+    printf("FILE... several files, or a file with several grids, are solved as a batch, in parallel with -j N, the results in the order of the grids\n");
     printf("-a, --all search for all possible solutions\n");
+    printf("-j N, --jobs N use N threads (all the solutions, or N different searches racing for the first one)\n");
+    printf("--search=backtrack|cdcl search of the first solution: backtracking (default) or clause learning\n");
+    printf("--propagate=basic|parity|probe rules on the lines (default), also equal / opposite links between cells, also try both values of each empty cell before a branch\n");
+    printf("--branch=around|line|patterns|activity cell of a branch: most filled cells around (default), in the line with the fewest empty cells, with the fewest valid patterns, or with the most dead ends\n");
+    printf("--grid=K solve only the K-th grid of FILE (from 1), directly found in a binary file\n");
+    printf("--format=text|line|bin format of the output grids: text (default), one line per grid, or binary, 2 bits per cell (only the grids, no messages)\n");
+    printf("--convert write the grids of the FILEs (text or binary) in the output format, without solving them\n");
+    printf("--stats[=text|json] print the number of nodes and solutions of the run and their rate on stderr, or in JSON also the backtracks, the max depth, the cells set by each rule, the consistency checks, the time in propagation / branching / validation and the peak memory\n");
+    printf("--trace=TRACE write the search tree (a node per branch: cell, value, cells propagated, failed or solution) in the binary file TRACE, read by tracetree\n");
+    printf("--seed=N seed of the random choices (generation, random branching) instead of the time\n");
     printf("-g[N], --generate[=N] generate a grid of size NxN (default:8)\n");
     printf("-o FILE, --output FILE write output to FILE\n");
     printf("-u, --unique generate a grid with unique solution\n");
+    printf("--dig-budget=N with -u, a clue is kept when its uniqueness test needs more than N branches: much faster on large grids, but the grid is not always minimal (default: exact tests)\n");
+    printf("--full generate a complete valid grid\n");
     printf("-v, --verbose verbose output\n");
     printf("-h, --help display this help and exit\n");
 }
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Round trip of the binary format: the grids generated (or solved) with --format=bin,
+# converted back to text with --convert, are the same as the ones written in text.
+# usage: binary.sh [TAKUZU]
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+TAKUZU=${1:-$DIR/../takuzu}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+fail=0
+
+check() {
+    # name, then the arguments of takuzu writing the grids
+    name=$1
+    shift
+    "$TAKUZU" "$@" -o "$TMP/text.txt" 2>/dev/null
+    # without -o: the binary grids go to the standard output
+    "$TAKUZU" "$@" --format=bin 2>/dev/null >"$TMP/grid.bin"
+    "$TAKUZU" --convert "$TMP/grid.bin" -o "$TMP/back.txt" 2>/dev/null
+    if cmp -s "$TMP/text.txt" "$TMP/back.txt"; then
+        echo "$name: OK"
+    else
+        echo "$name: FAIL"
+        fail=1
+    fi
+}
+
+for n in 4 8 16 32 64; do
+    check "generate/$n" -g$n --seed=1
+    check "generate/$n-full" -g$n --full --seed=1
+done
+for n in 4 8 16; do
+    check "generate/$n-unique" -g$n -u --seed=1
+done
+# the solutions only: the messages of the text output are not in the binary file
+"$TAKUZU" -a --format=bin "$DIR/g5.txt" 2>/dev/null >"$TMP/sol.bin"
+"$TAKUZU" -a --format=line "$DIR/g5.txt" 2>/dev/null | grep -v "^Number" >"$TMP/sol.txt"
+"$TAKUZU" --convert --format=line "$TMP/sol.bin" 2>/dev/null >"$TMP/back.txt"
+if cmp -s "$TMP/sol.txt" "$TMP/back.txt"; then
+    echo "solve/g5: OK"
+else
+    echo "solve/g5: FAIL"
+    fail=1
+fi
+
+exit $fail